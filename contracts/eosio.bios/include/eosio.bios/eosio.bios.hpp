@@ -51,6 +51,34 @@ namespace eosiobios {
       EOSLIB_SERIALIZE( authority, (threshold)(keys)(accounts)(waits) )
    };
 
+   /**
+    * An account in a `genesis` plan: the account to create, if it does not exist yet, along with
+    * its privilege and resource limits. A limit of -1 means unlimited.
+    */
+   struct genesis_account {
+      name       account;
+      authority  owner;
+      authority  active;
+      bool       is_priv    = false;
+      int64_t    ram_bytes  = -1;
+      int64_t    net_weight = -1;
+      int64_t    cpu_weight = -1;
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( genesis_account, (account)(owner)(active)(is_priv)(ram_bytes)(net_weight)(cpu_weight) )
+   };
+
+   /**
+    * A chain bootstrap plan applied by `genesis`: the accounts to set up and the producer schedule to propose.
+    */
+   struct genesis_plan {
+      std::vector<genesis_account>            accounts;
+      std::vector<eosio::producer_authority>  producers;
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( genesis_plan, (accounts)(producers) )
+   };
+
    struct block_header {
       uint32_t                                  timestamp;
       name                                      producer;
@@ -245,6 +273,28 @@ namespace eosiobios {
          [[eosio::action]]
          void activate( const eosio::checksum256& feature_digest );
 
+         /**
+          * Activate many action, activates several protocol features at once
+          *
+          * @param feature_digests - hashes of the protocol features to activate.
+          */
+         [[eosio::action]]
+         void activatemany( const std::vector<eosio::checksum256>& feature_digests );
+
+         /**
+          * Genesis action, applies a chain bootstrap plan in a single action. Accounts of the plan that do not exist
+          * yet are created by `eosio`, then every account of the plan gets its privilege status and resource limits,
+          * and finally the producer schedule is proposed if the plan has one. Accounts that already exist are set
+          * exactly as the plan says: a privileged account is unprivileged unless `is_priv` is set, and a limit left
+          * at -1 makes the account unlimited for that resource.
+          *
+          * @param plan - the accounts to set up and the producer schedule to propose.
+          *
+          * @pre Each account appears at most once in the plan
+          */
+         [[eosio::action]]
+         void genesis( const genesis_plan& plan );
+
          /**
           * Require activated action, asserts that a protocol feature has been activated
           *
@@ -277,6 +327,8 @@ namespace eosiobios {
          using setparams_action = action_wrapper<"setparams"_n, &bios::setparams>;
          using reqauth_action = action_wrapper<"reqauth"_n, &bios::reqauth>;
          using activate_action = action_wrapper<"activate"_n, &bios::activate>;
+         using activatemany_action = action_wrapper<"activatemany"_n, &bios::activatemany>;
+         using genesis_action = action_wrapper<"genesis"_n, &bios::genesis>;
          using reqactivated_action = action_wrapper<"reqactivated"_n, &bios::reqactivated>;
    };
 }
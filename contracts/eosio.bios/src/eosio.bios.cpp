@@ -1,5 +1,7 @@
 #include <eosio.bios/eosio.bios.hpp>
 
+#include <algorithm>
+
 namespace eosiobios {
 
 void bios::setabi( name account, const std::vector<char>& abi ) {
@@ -50,6 +52,45 @@ void bios::activate( const eosio::checksum256& feature_digest ) {
    preactivate_feature( feature_digest );
 }
 
+void bios::activatemany( const std::vector<eosio::checksum256>& feature_digests ) {
+   require_auth( get_self() );
+   for( const auto& digest : feature_digests ) {
+      preactivate_feature( digest );
+   }
+}
+
+void bios::genesis( const genesis_plan& plan ) {
+   require_auth( get_self() );
+   check( !plan.accounts.empty() || !plan.producers.empty(), "genesis plan is empty" );
+
+   // reject the plan before anything is created rather than have the second newaccount of an account fail
+   // or its later setpriv/setalimits silently win
+   std::vector<name> names;
+   names.reserve( plan.accounts.size() );
+   for( const auto& acct : plan.accounts ) {
+      names.push_back( acct.account );
+   }
+   std::sort( names.begin(), names.end() );
+   check( std::adjacent_find( names.begin(), names.end() ) == names.end(), "duplicate account in genesis plan" );
+
+   const permission_level active{ get_self(), "active"_n };
+   // new accounts only exist once their inline newaccount has run, so privileges and limits are applied
+   // through inline actions queued after it. Both are set whether or not the account existed, so the plan
+   // revokes privileges and lifts limits it does not list
+   for( const auto& acct : plan.accounts ) {
+      if( !eosio::is_account( acct.account ) ) {
+         eosio::action( active, get_self(), "newaccount"_n,
+                        std::make_tuple( get_self(), acct.account, acct.owner, acct.active ) ).send();
+      }
+      setpriv_action{ get_self(), { active } }.send( acct.account, acct.is_priv ? 1 : 0 );
+      setalimits_action{ get_self(), { active } }.send( acct.account, acct.ram_bytes, acct.net_weight, acct.cpu_weight );
+   }
+
+   if( !plan.producers.empty() ) {
+      set_proposed_producers( plan.producers );
+   }
+}
+
 void bios::reqactivated( const eosio::checksum256& feature_digest ) {
    check( is_feature_activated( feature_digest ), "protocol feature is not activated" );
 }
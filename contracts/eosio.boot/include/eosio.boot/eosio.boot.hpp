@@ -235,6 +235,16 @@ namespace eosioboot {
          [[eosio::action]]
          void activate( const eosio::checksum256& feature_digest );
 
+         /**
+          * Activates several protocol features.
+          *
+          * @details Activates several protocol features in a single action
+          *
+          * @param feature_digests - hashes of the protocol features to activate.
+          */
+         [[eosio::action]]
+         void activatemany( const std::vector<eosio::checksum256>& feature_digests );
+
          /**
           * Asserts that a protocol feature has been activated.
           *
@@ -254,6 +264,7 @@ namespace eosioboot {
          using setcode_action = action_wrapper<"setcode"_n, &boot::setcode>;
          using setabi_action = action_wrapper<"setabi"_n, &boot::setabi>;
          using activate_action = action_wrapper<"activate"_n, &boot::activate>;
+         using activatemany_action = action_wrapper<"activatemany"_n, &boot::activatemany>;
          using reqactivated_action = action_wrapper<"reqactivated"_n, &boot::reqactivated>;
    };
    /** @}*/ // end of @defgroup eosioboot eosio.boot
@@ -12,6 +12,13 @@ void boot::activate( const eosio::checksum256& feature_digest ) {
    eosio::preactivate_feature( feature_digest );
 }
 
+void boot::activatemany( const std::vector<eosio::checksum256>& feature_digests ) {
+   require_auth( get_self() );
+   for( const auto& digest : feature_digests ) {
+      eosio::preactivate_feature( digest );
+   }
+}
+
 void boot::reqactivated( const eosio::checksum256& feature_digest ) {
    check( eosio::is_feature_activated( feature_digest ), "protocol feature is not activated" );
 }
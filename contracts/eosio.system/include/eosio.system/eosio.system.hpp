@@ -12,6 +12,7 @@
 #include <eosio.system/native.hpp>
 
 #include <deque>
+#include <map>
 #include <optional>
 #include <string>
 #include <type_traits>
@@ -81,6 +82,20 @@ namespace eosiosystem {
    static constexpr int64_t  default_inflation_pay_factor  = 50000;   // producers pay share = 10000 / 50000 = 20% of the inflation
    static constexpr int64_t  default_votepay_factor        = 40000;   // per-block pay share = 10000 / 40000 = 25% of the producer pay
 
+   static constexpr uint32_t vote_weight_fraction_bits = 32; // vote weights are accounted in Q32 fixed point
+   static constexpr int64_t  vote_weight_epsilon       = int64_t(1) << vote_weight_fraction_bits; // vote weight changes up to 1 are not propagated
+   static constexpr int64_t  rex_vote_stake_drift_divisor = 10000; // passive REX vote stake revaluation once drift exceeds 0.01%
+
+   // Converts a legacy floating-point vote weight into its Q32 fixed-point representation
+   inline int128_t to_fixed_vote_weight( double weight ) {
+      return static_cast<int128_t>( weight * double( uint64_t(1) << vote_weight_fraction_bits ) );
+   }
+
+   // Converts a Q32 fixed-point vote weight into the floating-point view kept in the tables for readers of the ABI
+   inline double to_double_vote_weight( int128_t weight ) {
+      return double( weight ) / double( uint64_t(1) << vote_weight_fraction_bits );
+   }
+
 #ifdef SYSTEM_BLOCKCHAIN_PARAMETERS
    struct blockchain_parameters_v1 : eosio::blockchain_parameters
    {
@@ -153,15 +168,26 @@ namespace eosiosystem {
       int64_t              total_activated_stake = 0;
       time_point           thresh_activated_stake_time;
       uint16_t             last_producer_schedule_size = 0;
-      double               total_producer_vote_weight = 0; /// the sum of all producer votes
+      double               total_producer_vote_weight = 0; /// the sum of all producer votes, view of fixed_total_producer_vote_weight
       block_timestamp      last_name_close;
+      eosio::binary_extension<int128_t> fixed_total_producer_vote_weight; /// the sum of all producer votes in Q32 fixed point
+
+      int128_t get_total_producer_vote_weight()const {
+         return fixed_total_producer_vote_weight.has_value() ? *fixed_total_producer_vote_weight
+                                                             : to_fixed_vote_weight( total_producer_vote_weight );
+      }
+      void set_total_producer_vote_weight( int128_t weight ) {
+         fixed_total_producer_vote_weight.emplace( weight );
+         total_producer_vote_weight = to_double_vote_weight( weight );
+      }
 
       // explicit serialization macro is not necessary, used here only to improve compilation time
       EOSLIB_SERIALIZE_DERIVED( eosio_global_state, eosio::blockchain_parameters,
                                 (max_ram_size)(total_ram_bytes_reserved)(total_ram_stake)
                                 (last_producer_schedule_update)(last_pervote_bucket_fill)
                                 (pervote_bucket)(perblock_bucket)(total_unpaid_blocks)(total_activated_stake)(thresh_activated_stake_time)
-                                (last_producer_schedule_size)(total_producer_vote_weight)(last_name_close) )
+                                (last_producer_schedule_size)(total_producer_vote_weight)(last_name_close)
+                                (fixed_total_producer_vote_weight) )
    };
 
    // Defines new global state parameters added after version 1.0
@@ -171,20 +197,41 @@ namespace eosiosystem {
       uint16_t          new_ram_per_block = 0;
       block_timestamp   last_ram_increase;
       block_timestamp   last_block_num; /* deprecated */
-      double            total_producer_votepay_share = 0;
+      double            total_producer_votepay_share = 0; ///< view of fixed_total_producer_votepay_share
       uint8_t           revision = 0; ///< used to track version updates in the future.
+      eosio::binary_extension<int128_t> fixed_total_producer_votepay_share; ///< integer vote weight times seconds
+
+      int128_t get_total_producer_votepay_share()const {
+         return fixed_total_producer_votepay_share.has_value() ? *fixed_total_producer_votepay_share
+                                                               : static_cast<int128_t>( total_producer_votepay_share );
+      }
+      void set_total_producer_votepay_share( int128_t share ) {
+         fixed_total_producer_votepay_share.emplace( share );
+         total_producer_votepay_share = double( share );
+      }
 
       EOSLIB_SERIALIZE( eosio_global_state2, (new_ram_per_block)(last_ram_increase)(last_block_num)
-                        (total_producer_votepay_share)(revision) )
+                        (total_producer_votepay_share)(revision)(fixed_total_producer_votepay_share) )
    };
 
    // Defines new global state parameters added after version 1.3.0
    struct [[eosio::table("global3"), eosio::contract("eosio.system")]] eosio_global_state3 {
       eosio_global_state3() { }
       time_point        last_vpay_state_update;
-      double            total_vpay_share_change_rate = 0;
+      double            total_vpay_share_change_rate = 0; ///< view of fixed_total_vpay_share_change_rate
+      eosio::binary_extension<int128_t> fixed_total_vpay_share_change_rate; ///< Q32 fixed-point vote weight
 
-      EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate) )
+      int128_t get_total_vpay_share_change_rate()const {
+         return fixed_total_vpay_share_change_rate.has_value() ? *fixed_total_vpay_share_change_rate
+                                                               : to_fixed_vote_weight( total_vpay_share_change_rate );
+      }
+      void set_total_vpay_share_change_rate( int128_t rate ) {
+         fixed_total_vpay_share_change_rate.emplace( rate );
+         total_vpay_share_change_rate = to_double_vote_weight( rate );
+      }
+
+      EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate)
+                        (fixed_total_vpay_share_change_rate) )
    };
 
    // Defines new global state parameters to store inflation rate and distribution
@@ -271,15 +318,32 @@ namespace eosiosystem {
    };
 
    // Defines new producer info structure to be stored in new producer info table, added after version 1.3.0
+   // The fixed-point fields are the authoritative votepay share and vote tally of the producer; `votepay_share`
+   // here and `total_votes` in `producer_info` are kept as their floating-point views. Rows written before the
+   // fixed-point fields existed are migrated the next time they are updated.
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info2 {
-      name            owner;
-      double          votepay_share = 0;
-      time_point      last_votepay_share_update;
+      name                              owner;
+      double                            votepay_share = 0;
+      time_point                        last_votepay_share_update;
+      eosio::binary_extension<int128_t> fixed_votepay_share; // integer vote weight times seconds
+      eosio::binary_extension<int128_t> fixed_total_votes;   // Q32 fixed-point vote weight
 
       uint64_t primary_key()const { return owner.value; }
 
+      int128_t get_votepay_share()const {
+         return fixed_votepay_share.has_value() ? *fixed_votepay_share : static_cast<int128_t>( votepay_share );
+      }
+      int128_t get_total_votes( const producer_info& prod )const {
+         return fixed_total_votes.has_value() ? *fixed_total_votes : to_fixed_vote_weight( prod.total_votes );
+      }
+      void set_fixed_values( int128_t share, int128_t total_votes ) {
+         fixed_votepay_share.emplace( share );
+         fixed_total_votes.emplace( total_votes );
+         votepay_share = double( share );
+      }
+
       // explicit serialization macro is not necessary, used here only to improve compilation time
-      EOSLIB_SERIALIZE( producer_info2, (owner)(votepay_share)(last_votepay_share_update) )
+      EOSLIB_SERIALIZE( producer_info2, (owner)(votepay_share)(last_votepay_share_update)(fixed_votepay_share)(fixed_total_votes) )
    };
 
    // Voter info. Voter info stores information about the voter:
@@ -307,8 +371,31 @@ namespace eosiosystem {
       uint32_t            reserved2 = 0;
       eosio::asset        reserved3;
 
+      // Q32 fixed-point counterparts of `last_vote_weight` and `proxied_vote_weight`, which are kept as their
+      // floating-point views. Rows written before these fields existed are migrated the next time they are updated.
+      eosio::binary_extension<int128_t> fixed_last_vote_weight;
+      eosio::binary_extension<int128_t> fixed_proxied_vote_weight;
+
       uint64_t primary_key()const { return owner.value; }
 
+      int128_t get_last_vote_weight()const {
+         return fixed_last_vote_weight.has_value() ? *fixed_last_vote_weight : to_fixed_vote_weight( last_vote_weight );
+      }
+      int128_t get_proxied_vote_weight()const {
+         return fixed_proxied_vote_weight.has_value() ? *fixed_proxied_vote_weight : to_fixed_vote_weight( proxied_vote_weight );
+      }
+      // both extensions are always set together since a binary_extension can only be followed by binary_extensions holding no value
+      void set_last_vote_weight( int128_t weight ) {
+         fixed_proxied_vote_weight.emplace( get_proxied_vote_weight() );
+         fixed_last_vote_weight.emplace( weight );
+         last_vote_weight = to_double_vote_weight( weight );
+      }
+      void set_proxied_vote_weight( int128_t weight ) {
+         fixed_last_vote_weight.emplace( get_last_vote_weight() );
+         fixed_proxied_vote_weight.emplace( weight );
+         proxied_vote_weight = to_double_vote_weight( weight );
+      }
+
       enum class flags1_fields : uint32_t {
          ram_managed = 1,
          net_managed = 2,
@@ -316,7 +403,8 @@ namespace eosiosystem {
       };
 
       // explicit serialization macro is not necessary, used here only to improve compilation time
-      EOSLIB_SERIALIZE( voter_info, (owner)(proxy)(producers)(staked)(last_vote_weight)(proxied_vote_weight)(is_proxy)(flags1)(reserved2)(reserved3) )
+      EOSLIB_SERIALIZE( voter_info, (owner)(proxy)(producers)(staked)(last_vote_weight)(proxied_vote_weight)(is_proxy)(flags1)(reserved2)(reserved3)
+                        (fixed_last_vote_weight)(fixed_proxied_vote_weight) )
    };
 
 
@@ -338,6 +426,57 @@ namespace eosiosystem {
 
    typedef eosio::singleton< "global4"_n, eosio_global_state4 > global_state4_singleton;
 
+   // Holds the core symbol of the chain, written once by `init` (or `initcoresym` on older chains). Kept apart from the RAM market so that
+   // reading the core symbol is a single fixed-size lookup.
+   struct [[eosio::table("coresymbol"), eosio::contract("eosio.system")]] core_symbol_state {
+      symbol   core;
+
+      EOSLIB_SERIALIZE( core_symbol_state, (core) )
+   };
+
+   typedef eosio::singleton< "coresymbol"_n, core_symbol_state > core_symbol_singleton;
+
+   // A producer as ranked by votes at the last producer schedule update, `rank` starting at 1
+   struct ranked_producer {
+      uint16_t   rank = 0;
+      name       owner;
+      double     total_votes = 0;
+      uint16_t   location = 0;
+
+      EOSLIB_SERIALIZE( ranked_producer, (rank)(owner)(total_votes)(location) )
+   };
+
+   // Snapshot of the top producers written whenever a new producer schedule is proposed, so that the ranking
+   // behind the current schedule can be read as a single row instead of walking the `prototalvote` index:
+   // - `epoch` is incremented every time a new producer schedule is proposed
+   // - `last_update` is the block time of the schedule update that proposed it
+   // - `producers` are the ranked producers, highest votes first
+   struct [[eosio::table("prodranking"), eosio::contract("eosio.system")]] producer_ranking {
+      uint32_t                       epoch = 0;
+      block_timestamp                last_update;
+      std::vector<ranked_producer>   producers;
+
+      EOSLIB_SERIALIZE( producer_ranking, (epoch)(last_update)(producers) )
+   };
+
+   typedef eosio::singleton< "prodranking"_n, producer_ranking > producer_ranking_singleton;
+
+   // Governance-set block propagation latency between producer locations:
+   // - `locations` is the sorted list of the location codes covered
+   // - `latencies` is the row-major matrix of latencies in milliseconds, `latencies[i * n + j]` being the latency
+   //   from `locations[i]` to `locations[j]`
+   // At most `max_locations` locations are covered. While this table exists, the elected producers are ordered to keep the latency between consecutive producers low.
+   struct [[eosio::table("loclatency"), eosio::contract("eosio.system")]] location_latency {
+      std::vector<uint16_t>   locations;
+      std::vector<uint32_t>   latencies;
+
+      static constexpr size_t max_locations = 256;
+
+      EOSLIB_SERIALIZE( location_latency, (locations)(latencies) )
+   };
+
+   typedef eosio::singleton< "loclatency"_n, location_latency > location_latency_singleton;
+
    struct [[eosio::table, eosio::contract("eosio.system")]] user_resources {
       name          owner;
       asset         net_weight;
@@ -384,6 +523,36 @@ namespace eosiosystem {
    typedef eosio::multi_index< "delband"_n, delegated_bandwidth > del_bandwidth_table;
    typedef eosio::multi_index< "refunds"_n, refund_request >      refunds_table;
 
+   // `account_provision` structure underlying the transient account provisioning table written by `newaccounts`.
+   // An entry is consumed and erased by `native::newaccount` in the same transaction, it is defined by:
+   // - `version` defaulted to zero,
+   // - `account` the account being created,
+   // - `from` the account delegating the stake, the new account itself if ownership of the stake was transferred,
+   // - `ram_bytes` the bytes of RAM bought for the account,
+   // - `net_weight` the amount of CORE_SYMBOL staked for NET,
+   // - `cpu_weight` the amount of CORE_SYMBOL staked for CPU.
+   struct [[eosio::table, eosio::contract("eosio.system")]] account_provision {
+      uint8_t   version = 0;
+      name      account;
+      name      from;
+      int64_t   ram_bytes = 0;
+      asset     net_weight;
+      asset     cpu_weight;
+
+      uint64_t  primary_key()const { return account.value; }
+   };
+
+   typedef eosio::multi_index< "acctprov"_n, account_provision > account_provision_table;
+
+   // A single account to be created by `newaccounts`, defined by its name and its owner and active authorities.
+   struct new_account_params {
+      name        account;
+      authority   owner;
+      authority   active;
+
+      EOSLIB_SERIALIZE( new_account_params, (account)(owner)(active) )
+   };
+
    // `rex_pool` structure underlying the rex pool table. A rex pool table entry is defined by:
    // - `version` defaulted to zero,
    // - `total_lent` total amount of CORE_SYMBOL in open rex_loans
@@ -442,6 +611,14 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE(pair_time_point_sec_int64, (first)(second));
    };
 
+   // A loan number and an amount of tokens, as taken by the bulk loan funding actions
+   struct rex_loan_amount {
+      uint64_t loan_num;
+      asset    amount;
+
+      EOSLIB_SERIALIZE(rex_loan_amount, (loan_num)(amount));
+   };
+
    // `rex_return_buckets` structure underlying the rex return buckets table. A rex return buckets table is defined by:
    // - `version` defaulted to zero,
    // - `return_buckets` buckets of proceeds accumulated in 12-hour intervals
@@ -454,14 +631,74 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "retbuckets"_n, rex_return_buckets > rex_return_buckets_table;
 
+   // `rex_price_oracle` structure underlying the rex price oracle table. It integrates the REX price
+   // (`total_lendable / total_rex`) and the rent price (`total_rent / total_unlent`) over time, so that a
+   // time-weighted average price is the difference of two cumulative values divided by the time between them.
+   // A rex price oracle table entry is defined by:
+   // - `version` defaulted to zero,
+   // - `last_update` the last time the cumulative prices were advanced,
+   // - `price_cumulative` REX price integrated over time, in price-seconds,
+   // - `rent_cumulative` rent price integrated over time, in price-seconds,
+   // - `sample_interval` minimum number of seconds between two samples of the cumulative prices,
+   // - `num_samples` size of the `rex_price_sample` ring buffer, at most `max_num_samples` so that `setrexoracle`
+   //   can clear the whole buffer in one action,
+   // - `head` slot of the latest sample in the ring buffer
+   struct [[eosio::table,eosio::contract("eosio.system")]] rex_price_oracle {
+      uint8_t        version = 0;
+      time_point_sec last_update;
+      double         price_cumulative = 0;
+      double         rent_cumulative  = 0;
+      uint32_t       sample_interval  = default_sample_interval;
+      uint16_t       num_samples      = default_num_samples;
+      uint16_t       head             = 0;
+
+      static constexpr uint32_t default_sample_interval = 60 * 60; // 1 hour
+      static constexpr uint16_t default_num_samples     = 7 * 24;  // 7 days of hourly samples
+      static constexpr uint16_t max_num_samples         = 30 * 24; // 30 days of hourly samples
+
+      uint64_t primary_key()const { return 0; }
+   };
+
+   typedef eosio::multi_index< "rexoracle"_n, rex_price_oracle > rex_price_oracle_table;
+
+   // `rex_price_sample` structure underlying the rex price samples table, a ring buffer of snapshots of the
+   // `rex_price_oracle` cumulative prices. A rex price samples table entry is defined by:
+   // - `slot` position in the ring buffer,
+   // - `time` time of the snapshot,
+   // - `price_cumulative` cumulative REX price at `time`,
+   // - `rent_cumulative` cumulative rent price at `time`
+   struct [[eosio::table,eosio::contract("eosio.system")]] rex_price_sample {
+      uint16_t       slot = 0;
+      time_point_sec time;
+      double         price_cumulative = 0;
+      double         rent_cumulative  = 0;
+
+      uint64_t primary_key()const { return slot; }
+   };
+
+   typedef eosio::multi_index< "rexprices"_n, rex_price_sample > rex_price_sample_table;
+
+   // Current and time-weighted average REX and rent prices, as returned by `getrexprice`
+   struct rex_price_info {
+      double   rex_price       = 0;
+      double   rent_price      = 0;
+      double   twap_rex_price  = 0;
+      double   twap_rent_price = 0;
+      uint32_t twap_window     = 0; /// seconds actually covered by the averages
+
+      EOSLIB_SERIALIZE(rex_price_info, (rex_price)(rent_price)(twap_rex_price)(twap_rent_price)(twap_window));
+   };
+
    // `rex_fund` structure underlying the rex fund table. A rex fund table entry is defined by:
    // - `version` defaulted to zero,
    // - `owner` the owner of the rex fund,
-   // - `balance` the balance of the fund.
+   // - `balance` the balance of the fund,
+   // - `auto_fund_loans` whether expiring loans of the owner are topped up from the fund to cover renewal.
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_fund {
-      uint8_t version = 0;
-      name    owner;
-      asset   balance;
+      uint8_t                 version = 0;
+      name                    owner;
+      asset                   balance;
+      binary_extension<bool>  auto_fund_loans;
 
       uint64_t primary_key()const { return owner.value; }
    };
@@ -473,21 +710,30 @@ namespace eosiosystem {
    // - `owner` the owner of the rex fund,
    // - `vote_stake` the amount of CORE_SYMBOL currently included in owner's vote,
    // - `rex_balance` the amount of REX owned by owner,
-   // - `matured_rex` matured REX available for selling
+   // - `matured_rex` matured REX available for selling,
+   // - `rex_maturities` REX daily maturity buckets,
+   // - `rex_savings` REX in savings, which never matures. Version 0 rows lack this field and keep
+   //   savings as a last `rex_maturities` bucket at `time_point_sec::maximum()` instead.
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_balance {
+      static constexpr uint8_t current_version = 1;
+
       uint8_t version = 0;
       name    owner;
       asset   vote_stake;
       asset   rex_balance;
       int64_t matured_rex = 0;
       std::vector<pair_time_point_sec_int64> rex_maturities; /// REX daily maturity buckets
+      binary_extension<int64_t>              rex_savings;
 
       uint64_t primary_key()const { return owner.value; }
    };
 
    typedef eosio::multi_index< "rexbal"_n, rex_balance > rex_balance_table;
 
-   // `rex_loan` structure underlying the `rex_cpu_loan_table` and `rex_net_loan_table`. A rex net/cpu loan table entry is defined by:
+   // `rex_loan` structure underlying the legacy `rex_cpu_loan_table` and `rex_net_loan_table`. Rows left in these tables
+   // are moved into `rex_cpu_loan2_table` and `rex_net_loan2_table` by `rexexec`, when they expire, or when the loan is next
+   // funded/defunded.
+   // A rex net/cpu loan table entry is defined by:
    // - `version` defaulted to zero,
    // - `from` account creating and paying for loan,
    // - `receiver` account receiving rented resources,
@@ -522,6 +768,45 @@ namespace eosiosystem {
                                indexed_by<"byowner"_n, const_mem_fun<rex_loan, uint64_t, &rex_loan::by_owner>>
                              > rex_net_loan_table;
 
+   // `rex_loan2` structure underlying the `rex_cpu_loan2_table` and `rex_net_loan2_table`. It holds the same loan as `rex_loan`
+   // with amounts stored as core token units, and is additionally indexed by receiver. A rex net/cpu loan table entry is defined by:
+   // - `version` defaulted to zero,
+   // - `from` account creating and paying for loan,
+   // - `receiver` account receiving rented resources,
+   // - `payment` core token units paid for the loan,
+   // - `balance` core token units available to be used for loan auto-renewal,
+   // - `total_staked` core token units staked,
+   // - `loan_num` loan number/id,
+   // - `expiration` the expiration time when loan will be either closed or renewed
+   //       If payment <= balance, the loan is renewed, and closed otherwise.
+   struct [[eosio::table,eosio::contract("eosio.system")]] rex_loan2 {
+      uint8_t             version = 0;
+      name                from;
+      name                receiver;
+      int64_t             payment = 0;
+      int64_t             balance = 0;
+      int64_t             total_staked = 0;
+      uint64_t            loan_num;
+      eosio::time_point   expiration;
+
+      uint64_t primary_key()const { return loan_num;                   }
+      uint64_t by_expr()const     { return expiration.elapsed.count(); }
+      uint64_t by_owner()const    { return from.value;                 }
+      uint64_t by_receiver()const { return receiver.value;             }
+   };
+
+   typedef eosio::multi_index< "cpuloan2"_n, rex_loan2,
+                               indexed_by<"byexpr"_n,     const_mem_fun<rex_loan2, uint64_t, &rex_loan2::by_expr>>,
+                               indexed_by<"byowner"_n,    const_mem_fun<rex_loan2, uint64_t, &rex_loan2::by_owner>>,
+                               indexed_by<"byreceiver"_n, const_mem_fun<rex_loan2, uint64_t, &rex_loan2::by_receiver>>
+                             > rex_cpu_loan2_table;
+
+   typedef eosio::multi_index< "netloan2"_n, rex_loan2,
+                               indexed_by<"byexpr"_n,     const_mem_fun<rex_loan2, uint64_t, &rex_loan2::by_expr>>,
+                               indexed_by<"byowner"_n,    const_mem_fun<rex_loan2, uint64_t, &rex_loan2::by_owner>>,
+                               indexed_by<"byreceiver"_n, const_mem_fun<rex_loan2, uint64_t, &rex_loan2::by_receiver>>
+                             > rex_net_loan2_table;
+
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_order {
       uint8_t             version = 0;
       name                owner;
@@ -545,6 +830,19 @@ namespace eosiosystem {
       asset stake_change;
    };
 
+   // Iterators to the REX fund, balance and order rows of one owner, loaded together once per action
+   struct rex_account_rows {
+      rex_fund_table::const_iterator    fund;
+      rex_balance_table::const_iterator balance;
+      rex_order_table::const_iterator   order;
+   };
+
+   // Values the REX helpers share for the duration of one action
+   struct rex_action_context {
+      time_point     now;      /// current block time
+      time_point_sec maturity; /// maturity date of REX bought in this action
+   };
+
    struct powerup_config_resource {
       std::optional<int64_t>        current_weight_ratio;   // Immediately set weight_ratio to this amount. 1x = 10^15. 0.01x = 10^13.
                                                             //    Do not specify to preserve the existing setting or use the default;
@@ -662,6 +960,60 @@ namespace eosiosystem {
                                indexed_by<"byexpires"_n, const_mem_fun<powerup_order, uint64_t, &powerup_order::by_expires>>
                                > powerup_order_table;
 
+   // Table handle constructed on first use, so that an action only pays for the tables it actually touches.
+   template<typename Table>
+   class lazy_table {
+      public:
+         lazy_table( name code, uint64_t scope ) : _code(code), _scope(scope) {}
+
+         Table& operator*()const {
+            if( !_table ) _table.emplace( _code, _scope );
+            return *_table;
+         }
+         Table* operator->()const { return &**this; }
+
+      private:
+         name                          _code;
+         uint64_t                      _scope;
+         mutable std::optional<Table>  _table;
+   };
+
+   // Global state stored in a singleton. The state is read on first use and `save` writes it back only if it
+   // was modified since it was read, or if the singleton does not exist yet.
+   template<typename Singleton, typename State>
+   class lazy_global {
+      public:
+         lazy_global( name code, uint64_t scope, State (*make_default)() = nullptr )
+         :_singleton(code, scope), _make_default(make_default) {}
+
+         State& operator*() {
+            if( !_state ) {
+               if( _singleton.exists() ) {
+                  _state.emplace( _singleton.get() );
+                  _original = eosio::pack( *_state );
+               } else {
+                  _state.emplace( _make_default ? _make_default() : State{} );
+               }
+            }
+            return *_state;
+         }
+         State* operator->() { return &**this; }
+
+         void save( name payer ) {
+            if( !_state ) return;
+            auto packed = eosio::pack( *_state );
+            if( !_original.empty() && packed == _original ) return;
+            _singleton.set( *_state, payer );
+            _original = std::move( packed );
+         }
+
+      private:
+         Singleton             _singleton;
+         State               (*_make_default)();
+         std::optional<State>  _state;
+         std::vector<char>     _original;
+   };
+
    /**
     * The `eosio.system` smart contract is provided by `block.one` as a sample system contract, and it defines the structures and actions needed for blockchain's core functionality.
     *
@@ -679,24 +1031,23 @@ namespace eosiosystem {
    class [[eosio::contract("eosio.system")]] system_contract : public native {
 
       private:
-         voters_table             _voters;
-         producers_table          _producers;
-         producers_table2         _producers2;
-         global_state_singleton   _global;
-         global_state2_singleton  _global2;
-         global_state3_singleton  _global3;
-         global_state4_singleton  _global4;
-         eosio_global_state       _gstate;
-         eosio_global_state2      _gstate2;
-         eosio_global_state3      _gstate3;
-         eosio_global_state4      _gstate4;
-         rammarket                _rammarket;
-         rex_pool_table           _rexpool;
-         rex_return_pool_table    _rexretpool;
-         rex_return_buckets_table _rexretbuckets;
-         rex_fund_table           _rexfunds;
-         rex_balance_table        _rexbalance;
-         rex_order_table          _rexorders;
+         lazy_table<voters_table>                                       _voters;
+         lazy_table<producers_table>                                    _producers;
+         lazy_table<producers_table2>                                   _producers2;
+         lazy_global<global_state_singleton, eosio_global_state>        _gstate;
+         lazy_global<global_state2_singleton, eosio_global_state2>      _gstate2;
+         lazy_global<global_state3_singleton, eosio_global_state3>      _gstate3;
+         lazy_global<global_state4_singleton, eosio_global_state4>      _gstate4;
+         lazy_table<rammarket>                                          _rammarket;
+         lazy_table<rex_pool_table>                                     _rexpool;
+         lazy_table<rex_return_pool_table>                              _rexretpool;
+         lazy_table<rex_return_buckets_table>                           _rexretbuckets;
+         lazy_table<rex_fund_table>                                     _rexfunds;
+         lazy_table<rex_balance_table>                                  _rexbalance;
+         lazy_table<rex_order_table>                                    _rexorders;
+         std::map<uint64_t, rex_account_rows>                           _rex_accounts;
+         std::optional<rex_action_context>                              _rex_context;
+         mutable std::optional<symbol>                                  _core_symbol;
 
       public:
          static constexpr eosio::name active_permission{"active"_n};
@@ -721,8 +1072,12 @@ namespace eosiosystem {
           // Returns the core symbol by system account name
           // @param system_account - the system account to get the core symbol for.
          static symbol get_core_symbol( name system_account = "eosio"_n ) {
-            rammarket rm(system_account, system_account.value);
-            const static auto sym = get_core_symbol( rm );
+            const static auto sym = [&]() {
+               core_symbol_singleton cs(system_account, system_account.value);
+               if( cs.exists() ) return cs.get().core;
+               rammarket rm(system_account, system_account.value);
+               return get_core_symbol( rm );
+            }();
             return sym;
          }
 
@@ -741,6 +1096,13 @@ namespace eosiosystem {
          [[eosio::action]]
          void init( unsigned_int version, const symbol& core );
 
+         /**
+          * Records the core symbol in the `coresymbol` singleton on a chain initialized before that singleton
+          * existed, reading it from the RAM market. Until then the core symbol keeps being read from the RAM market.
+          */
+         [[eosio::action]]
+         void initcoresym();
+
          /**
           * On block action. This special action is triggered when a block is applied by the given producer
           * and cannot be generated from any other source. It is used to pay producers and calculate
@@ -819,6 +1181,7 @@ namespace eosiosystem {
          void delegatebw( const name& from, const name& receiver,
                           const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
 
+#ifdef SYSTEM_REX
          /**
           * Setrex action, sets total_rent balance of REX pool to the passed value.
           * @param balance - amount to set the REX pool balance.
@@ -993,6 +1356,64 @@ namespace eosiosystem {
          [[eosio::action]]
          void defnetloan( const name& from, uint64_t loan_num, const asset& amount );
 
+         /**
+          * Fundloans action, transfers tokens from REX fund to the funds of several CPU and NET loans
+          * in one go. The REX fund is debited once with the total.
+          *
+          * @param from - loan creator account,
+          * @param cpu_loans - CPU loan ids and tokens transferred to each loan fund,
+          * @param net_loans - NET loan ids and tokens transferred to each loan fund.
+          */
+         [[eosio::action]]
+         void fundloans( const name& from, const std::vector<rex_loan_amount>& cpu_loans, const std::vector<rex_loan_amount>& net_loans );
+
+         /**
+          * Defundloans action, withdraws tokens from the funds of several CPU and NET loans and adds
+          * them to REX fund in one go. The REX fund is credited once with the total.
+          *
+          * @param from - loan creator account,
+          * @param cpu_loans - CPU loan ids and tokens withdrawn from each loan fund,
+          * @param net_loans - NET loan ids and tokens withdrawn from each loan fund.
+          */
+         [[eosio::action]]
+         void defundloans( const name& from, const std::vector<rex_loan_amount>& cpu_loans, const std::vector<rex_loan_amount>& net_loans );
+
+         /**
+          * Autofundloan action, opts the owner in or out of automatic loan funding. When enabled and a
+          * loan of the owner expires with a balance below its payment, the shortfall is taken out of
+          * the owner REX fund so that the loan is renewed instead of closed.
+          *
+          * @param owner - REX fund owner account,
+          * @param enabled - whether expiring loans are topped up from REX fund.
+          *
+          * @pre REX fund record of owner must exist
+          */
+         [[eosio::action]]
+         void autofundloan( const name& owner, bool enabled );
+
+         /**
+          * Setrexoracle action, sets the sampling of the REX price oracle and clears its sample history.
+          *
+          * @param sample_interval - minimum number of seconds between two samples,
+          * @param num_samples - number of samples kept, which bounds the longest averaging window.
+          *
+          * @pre num_samples must be positive and no more than `rex_price_oracle::max_num_samples`
+          */
+         [[eosio::action]]
+         void setrexoracle( uint32_t sample_interval, uint16_t num_samples );
+
+         /**
+          * Get REX price action, a read-only action returning the current REX and rent prices along with
+          * their time-weighted averages over about `window` seconds, read from the REX price oracle.
+          *
+          * @param window - averaging window in seconds, rounded down to a multiple of the sample interval
+          *    and capped by the number of samples kept.
+          *
+          * @return the prices and the number of seconds the averages actually cover.
+          */
+         [[eosio::action, eosio::read_only]]
+         rex_price_info getrexprice( uint32_t window );
+
          /**
           * Updaterex action, updates REX owner vote weight to current value of held REX tokens.
           *
@@ -1003,6 +1424,7 @@ namespace eosiosystem {
 
          /**
           * Rexexec action, processes max CPU loans, max NET loans, and max queued sellrex orders.
+          * It also moves up to max CPU and max NET loans left in the legacy loan tables into the compact ones.
           * Action does not execute anything related to a specific user.
           *
           * @param user - any account can execute this action,
@@ -1055,6 +1477,7 @@ namespace eosiosystem {
           */
          [[eosio::action]]
          void closerex( const name& owner );
+#endif
 
          /**
           * Undelegate bandwidth action, decreases the total tokens delegated by `from` to `receiver` and/or
@@ -1110,6 +1533,26 @@ namespace eosiosystem {
          [[eosio::action]]
          void buyrambytes( const name& payer, const name& receiver, uint32_t bytes );
 
+         /**
+          * New accounts action, creates a batch of accounts that share a single RAM purchase and stake.
+          * RAM for all accounts is priced once against the market and paid in a single purchase, the stake
+          * for all accounts is transferred in a single inline transfer, and the resource limits of each new
+          * account are set once, when the account is created.
+          *
+          * @param creator - the account creating the new accounts and paying for their resources,
+          * @param accounts - the names and authorities of the accounts to create,
+          * @param ram_bytes - the quantity of ram to buy for each account, specified in bytes,
+          * @param stake_net_quantity - tokens staked for NET bandwidth for each account,
+          * @param stake_cpu_quantity - tokens staked for CPU bandwidth for each account,
+          * @param transfer - if true, ownership of the staked tokens is transferred to each new account.
+          *
+          * @pre `accounts` must not be empty and must not contain duplicate names.
+          * @post Bytes bought are split evenly between the new accounts, any remainder goes to the first one.
+          */
+         [[eosio::action]]
+         void newaccounts( const name& creator, const std::vector<new_account_params>& accounts, uint32_t ram_bytes,
+                           const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
+
          /**
           * Sell ram action, reduces quota by bytes and then performs an inline transfer of tokens
           * to receiver based upon the average purchase price of the original quota.
@@ -1294,6 +1737,18 @@ namespace eosiosystem {
          [[eosio::action]]
          void updtrevision( uint8_t revision );
 
+         /**
+          * Get ABI hashes action, a read-only action returning the hash of the ABI currently set on each
+          * of `accounts`, in the same order, so that the freshness of many ABIs can be checked in one call.
+          *
+          * @param accounts - the accounts to look up.
+          *
+          * @return the `abi_hash` of each account, accounts without an ABI have an empty hash.
+          */
+         [[eosio::action, eosio::read_only]]
+         std::vector<abi_hash> getabihashes( const std::vector<name>& accounts );
+
+#ifdef SYSTEM_NAME_BIDDING
          /**
           * Bid name action, allows an account `bidder` to place a bid for a name `newname`.
           * @param bidder - the account placing the bid,
@@ -1321,6 +1776,7 @@ namespace eosiosystem {
           */
          [[eosio::action]]
          void bidrefund( const name& bidder, const name& newname );
+#endif
 
          /**
           * Change the annual inflation rate of the core token supply and specify how
@@ -1341,6 +1797,21 @@ namespace eosiosystem {
          [[eosio::action]]
          void setinflation( int64_t annual_rate, int64_t inflation_pay_factor, int64_t votepay_factor );
 
+         /**
+          * Set the block propagation latency between producer locations, used to order the producer schedule.
+          * While latencies are set, the elected producers are ordered to minimize the latency between
+          * consecutive producers instead of being ordered by name.
+          *
+          * @param locations - Sorted list of the location codes covered, empty to restore ordering by name.
+          * @param latencies - Row-major matrix of latencies in milliseconds, `latencies[i * n + j]` being the latency
+          *     from `locations[i]` to `locations[j]`, where `n` is the number of locations.
+          *
+          * @pre At most `location_latency::max_locations` locations
+          */
+         [[eosio::action]]
+         void setlatency( const std::vector<uint16_t>& locations, const std::vector<uint32_t>& latencies );
+
+#ifdef SYSTEM_POWERUP
          /**
           * Configure the `power` market. The market becomes available the first time this
           * action is invoked.
@@ -1370,7 +1841,9 @@ namespace eosiosystem {
           */
          [[eosio::action]]
          void powerup( const name& payer, const name& receiver, uint32_t days, int64_t net_frac, int64_t cpu_frac, const asset& max_payment );
+#endif
 
+#ifdef SYSTEM_LIMIT_AUTH_CHANGES
          /**
           * limitauthchg opts into or out of restrictions on updateauth, deleteauth, linkauth, and unlinkauth.
           *
@@ -1388,13 +1861,16 @@ namespace eosiosystem {
           */
          [[eosio::action]]
          void limitauthchg( const name& account, const std::vector<name>& allow_perms, const std::vector<name>& disallow_perms );
+#endif
 
          using init_action = eosio::action_wrapper<"init"_n, &system_contract::init>;
+         using initcoresym_action = eosio::action_wrapper<"initcoresym"_n, &system_contract::initcoresym>;
          using setacctram_action = eosio::action_wrapper<"setacctram"_n, &system_contract::setacctram>;
          using setacctnet_action = eosio::action_wrapper<"setacctnet"_n, &system_contract::setacctnet>;
          using setacctcpu_action = eosio::action_wrapper<"setacctcpu"_n, &system_contract::setacctcpu>;
          using activate_action = eosio::action_wrapper<"activate"_n, &system_contract::activate>;
          using delegatebw_action = eosio::action_wrapper<"delegatebw"_n, &system_contract::delegatebw>;
+#ifdef SYSTEM_REX
          using deposit_action = eosio::action_wrapper<"deposit"_n, &system_contract::deposit>;
          using withdraw_action = eosio::action_wrapper<"withdraw"_n, &system_contract::withdraw>;
          using buyrex_action = eosio::action_wrapper<"buyrex"_n, &system_contract::buyrex>;
@@ -1407,6 +1883,11 @@ namespace eosiosystem {
          using fundnetloan_action = eosio::action_wrapper<"fundnetloan"_n, &system_contract::fundnetloan>;
          using defcpuloan_action = eosio::action_wrapper<"defcpuloan"_n, &system_contract::defcpuloan>;
          using defnetloan_action = eosio::action_wrapper<"defnetloan"_n, &system_contract::defnetloan>;
+         using fundloans_action = eosio::action_wrapper<"fundloans"_n, &system_contract::fundloans>;
+         using defundloans_action = eosio::action_wrapper<"defundloans"_n, &system_contract::defundloans>;
+         using autofundloan_action = eosio::action_wrapper<"autofundloan"_n, &system_contract::autofundloan>;
+         using setrexoracle_action = eosio::action_wrapper<"setrexoracle"_n, &system_contract::setrexoracle>;
+         using getrexprice_action = eosio::action_wrapper<"getrexprice"_n, &system_contract::getrexprice>;
          using updaterex_action = eosio::action_wrapper<"updaterex"_n, &system_contract::updaterex>;
          using rexexec_action = eosio::action_wrapper<"rexexec"_n, &system_contract::rexexec>;
          using setrex_action = eosio::action_wrapper<"setrex"_n, &system_contract::setrex>;
@@ -1414,9 +1895,11 @@ namespace eosiosystem {
          using mvfrsavings_action = eosio::action_wrapper<"mvfrsavings"_n, &system_contract::mvfrsavings>;
          using consolidate_action = eosio::action_wrapper<"consolidate"_n, &system_contract::consolidate>;
          using closerex_action = eosio::action_wrapper<"closerex"_n, &system_contract::closerex>;
+#endif
          using undelegatebw_action = eosio::action_wrapper<"undelegatebw"_n, &system_contract::undelegatebw>;
          using buyram_action = eosio::action_wrapper<"buyram"_n, &system_contract::buyram>;
          using buyrambytes_action = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
+         using newaccounts_action = eosio::action_wrapper<"newaccounts"_n, &system_contract::newaccounts>;
          using sellram_action = eosio::action_wrapper<"sellram"_n, &system_contract::sellram>;
          using refund_action = eosio::action_wrapper<"refund"_n, &system_contract::refund>;
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &system_contract::regproducer>;
@@ -1430,15 +1913,21 @@ namespace eosiosystem {
          using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
          using rmvproducer_action = eosio::action_wrapper<"rmvproducer"_n, &system_contract::rmvproducer>;
          using updtrevision_action = eosio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
+         using getabihashes_action = eosio::action_wrapper<"getabihashes"_n, &system_contract::getabihashes>;
+#ifdef SYSTEM_NAME_BIDDING
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
          using bidrefund_action = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
+#endif
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
          using setalimits_action = eosio::action_wrapper<"setalimits"_n, &system_contract::setalimits>;
          using setparams_action = eosio::action_wrapper<"setparams"_n, &system_contract::setparams>;
          using setinflation_action = eosio::action_wrapper<"setinflation"_n, &system_contract::setinflation>;
+         using setlatency_action = eosio::action_wrapper<"setlatency"_n, &system_contract::setlatency>;
+#ifdef SYSTEM_POWERUP
          using cfgpowerup_action = eosio::action_wrapper<"cfgpowerup"_n, &system_contract::cfgpowerup>;
          using powerupexec_action = eosio::action_wrapper<"powerupexec"_n, &system_contract::powerupexec>;
          using powerup_action = eosio::action_wrapper<"powerup"_n, &system_contract::powerup>;
+#endif
 
       private:
          // Implementation details:
@@ -1456,57 +1945,75 @@ namespace eosiosystem {
          void update_ram_supply();
 
          // defined in rex.cpp
-         void runrex( uint16_t max );
+         void runrex( uint16_t max, bool migrate_loans = false );
          void update_rex_pool();
+         void update_rex_price_oracle();
+         void put_rex_price_sample( uint16_t slot, const time_point_sec& time, double price_cumulative, double rent_cumulative );
+         static std::pair<double, double> get_rex_prices( const rex_pool& pool );
          void update_resource_limits( const name& from, const name& receiver, int64_t delta_net, int64_t delta_cpu );
          void check_voting_requirement( const name& owner,
                                         const char* error_msg = "must vote for at least 21 producers or for a proxy before buying REX" )const;
-         rex_order_outcome fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex );
+         rex_order_outcome fill_rex_order( rex_balance& rb, const asset& rex );
+         rex_account_rows& get_rex_account( const name& owner );
          asset update_rex_account( const name& owner, const asset& proceeds, const asset& unstake_quant, bool force_vote_update = false );
          void channel_to_rex( const name& from, const asset& amount, bool required = false );
+         bool pay_fee_to_rex( const name& payer, const asset& fee, const std::string& memo );
          void channel_namebid_to_rex( const int64_t highest_bid );
          template <typename T>
          int64_t rent_rex( T& table, const name& from, const name& receiver, const asset& loan_payment, const asset& loan_fund );
-         template <typename T>
-         void fund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& payment );
-         template <typename T>
-         void defund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& amount );
+         template <typename T, typename L>
+         void fund_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, const asset& payment );
+         template <typename T, typename L>
+         void defund_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, const asset& amount );
+         template <typename T, typename L>
+         void credit_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, int64_t amount );
+         template <typename T, typename L>
+         void debit_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, int64_t amount );
+         template <typename T, typename L>
+         typename T::const_iterator migrate_rex_loan( T& table, L& legacy, typename L::const_iterator itr );
+         template <typename T, typename L>
+         typename T::const_iterator find_rex_loan( T& table, L& legacy, uint64_t loan_num );
          void transfer_from_fund( const name& owner, const asset& amount );
          void transfer_to_fund( const name& owner, const asset& amount );
+         int64_t auto_fund_loan( const name& owner, int64_t shortfall );
          bool rex_loans_available()const;
-         bool rex_system_initialized()const { return _rexpool.begin() != _rexpool.end(); }
-         bool rex_available()const { return rex_system_initialized() && _rexpool.begin()->total_rex.amount > 0; }
-         static time_point_sec get_rex_maturity();
+         bool rex_system_initialized()const { return _rexpool->begin() != _rexpool->end(); }
+         bool rex_available()const { return rex_system_initialized() && _rexpool->begin()->total_rex.amount > 0; }
+         const rex_action_context& get_rex_context();
+         time_point_sec get_rex_maturity();
          asset add_to_rex_balance( const name& owner, const asset& payment, const asset& rex_received );
          asset add_to_rex_pool( const asset& payment );
          void add_to_rex_return_pool( const asset& fee );
-         void process_rex_maturities( const rex_balance_table::const_iterator& bitr );
-         void consolidate_rex_balance( const rex_balance_table::const_iterator& bitr,
-                                       const asset& rex_in_sell_order );
-         int64_t read_rex_savings( const rex_balance_table::const_iterator& bitr );
-         void put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex );
+         static void migrate_rex_balance( rex_balance& rb );
+         void add_rex_maturity( rex_balance& rb, int64_t rex );
+         void process_rex_maturities( rex_balance& rb );
+         void consolidate_rex_balance( rex_balance& rb, const asset& rex_in_sell_order );
+         static int64_t read_rex_savings( const rex_balance& rb );
+         static void put_rex_savings( rex_balance& rb, int64_t rex );
          void update_rex_stake( const name& voter );
 
          void add_loan_to_rex_pool( const asset& payment, int64_t rented_tokens, bool new_loan );
-         void remove_loan_from_rex_pool( const rex_loan& loan );
+         void remove_loan_from_rex_pool( const rex_loan2& loan );
          template <typename Index, typename Iterator>
-         int64_t update_renewed_loan( Index& idx, const Iterator& itr, int64_t rented_tokens );
+         int64_t update_renewed_loan( Index& idx, const Iterator& itr, int64_t rented_tokens, int64_t top_up );
 
          // defined in delegate_bandwidth.cpp
          void changebw( name from, const name& receiver,
                         const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
          void update_voting_power( const name& voter, const asset& total_update );
+         int64_t purchase_ram( const name& payer, const asset& quant );
 
          // defined in voting.cpp
          void register_producer( const name& producer, const eosio::block_signing_authority& producer_authority, const std::string& url, uint16_t location );
          void update_elected_producers( const block_timestamp& timestamp );
          void update_votes( const name& voter, const name& proxy, const std::vector<name>& producers, bool voting );
-         void propagate_weight_change( const voter_info& voter );
-         double update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
-                                               const time_point& ct,
-                                               double shares_rate, bool reset_to_zero = false );
-         double update_total_votepay_share( const time_point& ct,
-                                            double additional_shares_delta = 0.0, double shares_rate_delta = 0.0 );
+         void propagate_weight_change( const voter_info& voter, int128_t proxied_delta = 0 );
+         uint32_t update_producer_votes( const std::vector<name>& producers, int128_t delta );
+         int128_t update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
+                                                 const time_point& ct,
+                                                 int128_t shares_rate, int128_t total_votes, bool reset_to_zero = false );
+         int128_t update_total_votepay_share( const time_point& ct,
+                                              int128_t additional_shares_delta = 0, int128_t shares_rate_delta = 0 );
 
          template <auto system_contract::*...Ptrs>
          class registration {
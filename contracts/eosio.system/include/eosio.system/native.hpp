@@ -119,6 +119,8 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( abi_hash, (owner)(hash) )
    };
 
+   typedef eosio::multi_index< "abihash"_n, abi_hash > abi_hash_table;
+
    void check_auth_change(name contract, name account, const binary_extension<name>& authorized_by);
 
    // Method parameters commented out to prevent generation of code that parses input data.
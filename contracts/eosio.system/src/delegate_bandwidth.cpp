@@ -23,7 +23,7 @@ namespace eosiosystem {
     *  This action will buy an exact amount of ram and bill the payer the current market price.
     */
    void system_contract::buyrambytes( const name& payer, const name& receiver, uint32_t bytes ) {
-      auto itr = _rammarket.find(ramcore_symbol.raw());
+      auto itr = _rammarket->find(ramcore_symbol.raw());
       const int64_t ram_reserve   = itr->base.balance.amount;
       const int64_t eos_reserve   = itr->quote.balance.amount;
       const int64_t cost          = exchange_state::get_bancor_input( ram_reserve, eos_reserve, bytes );
@@ -33,16 +33,12 @@ namespace eosiosystem {
 
 
    /**
-    *  When buying ram the payer irreversibly transfers quant to system contract and only
-    *  the receiver may reclaim the tokens via the sellram action. The receiver pays for the
-    *  storage of all database records associated with this action.
-    *
-    *  RAM is a scarce resource whose supply is defined by global properties max_ram_size. RAM is
-    *  priced using the bancor algorithm such that price-per-byte with a constant reserve ratio of 100:1.
+    *  Pays `quant` from `payer` into the RAM market and returns the number of bytes bought. The 0.5% fee is
+    *  paid straight to REX when fees are channeled there, otherwise to eosio.ramfee. The caller is responsible for crediting the bytes
+    *  to the receiving account(s) and updating their resource limits.
     */
-   void system_contract::buyram( const name& payer, const name& receiver, const asset& quant )
+   int64_t system_contract::purchase_ram( const name& payer, const asset& quant )
    {
-      require_auth( payer );
       update_ram_supply();
 
       check( quant.symbol == core_symbol(), "must buy ram with core token" );
@@ -61,23 +57,39 @@ namespace eosiosystem {
          token::transfer_action transfer_act{ token_account, { {payer, active_permission}, {ram_account, active_permission} } };
          transfer_act.send( payer, ram_account, quant_after_fee, "buy ram" );
       }
-      if ( fee.amount > 0 ) {
+      if ( fee.amount > 0 && !pay_fee_to_rex( payer, fee, "ram fee" ) ) {
          token::transfer_action transfer_act{ token_account, { {payer, active_permission} } };
          transfer_act.send( payer, ramfee_account, fee, "ram fee" );
-         channel_to_rex( ramfee_account, fee );
       }
 
       int64_t bytes_out;
 
-      const auto& market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
-      _rammarket.modify( market, same_payer, [&]( auto& es ) {
+      const auto& market = _rammarket->get(ramcore_symbol.raw(), "ram market does not exist");
+      _rammarket->modify( market, same_payer, [&]( auto& es ) {
          bytes_out = es.direct_convert( quant_after_fee,  ram_symbol ).amount;
       });
 
       check( bytes_out > 0, "must reserve a positive amount" );
 
-      _gstate.total_ram_bytes_reserved += uint64_t(bytes_out);
-      _gstate.total_ram_stake          += quant_after_fee.amount;
+      _gstate->total_ram_bytes_reserved += uint64_t(bytes_out);
+      _gstate->total_ram_stake          += quant_after_fee.amount;
+
+      return bytes_out;
+   }
+
+   /**
+    *  When buying ram the payer irreversibly transfers quant to system contract and only
+    *  the receiver may reclaim the tokens via the sellram action. The receiver pays for the
+    *  storage of all database records associated with this action.
+    *
+    *  RAM is a scarce resource whose supply is defined by global properties max_ram_size. RAM is
+    *  priced using the bancor algorithm such that price-per-byte with a constant reserve ratio of 100:1.
+    */
+   void system_contract::buyram( const name& payer, const name& receiver, const asset& quant )
+   {
+      require_auth( payer );
+
+      const int64_t bytes_out = purchase_ram( payer, quant );
 
       user_resources_table  userres( get_self(), receiver.value );
       auto res_itr = userres.find( receiver.value );
@@ -94,14 +106,70 @@ namespace eosiosystem {
             });
       }
 
-      auto voter_itr = _voters.find( res_itr->owner.value );
-      if( voter_itr == _voters.end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
+      auto voter_itr = _voters->find( res_itr->owner.value );
+      if( voter_itr == _voters->end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
          int64_t ram_bytes, net, cpu;
          get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
          set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
       }
    }
 
+   /**
+    *  Creates a batch of accounts with a single RAM purchase and a single stake transfer. The resources of
+    *  each account are recorded in the `acctprov` table and applied by `native::newaccount`, which sets the
+    *  account's resource limits exactly once.
+    */
+   void system_contract::newaccounts( const name& creator, const std::vector<new_account_params>& accounts, uint32_t ram_bytes,
+                                      const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer )
+   {
+      require_auth( creator );
+
+      const asset zero_asset( 0, core_symbol() );
+      check( !accounts.empty(), "must create at least one account" );
+      check( stake_net_quantity >= zero_asset, "must stake a positive amount" );
+      check( stake_cpu_quantity >= zero_asset, "must stake a positive amount" );
+
+      const int64_t count = accounts.size();
+
+      int64_t bytes_out = 0;
+      if( ram_bytes > 0 ) {
+         auto itr = _rammarket->find(ramcore_symbol.raw());
+         const int64_t ram_reserve   = itr->base.balance.amount;
+         const int64_t eos_reserve   = itr->quote.balance.amount;
+         const int64_t cost          = exchange_state::get_bancor_input( ram_reserve, eos_reserve, int64_t(ram_bytes) * count );
+         const int64_t cost_plus_fee = cost / double(0.995);
+         bytes_out = purchase_ram( creator, asset{ cost_plus_fee, core_symbol() } );
+      }
+
+      const asset total_stake = ( stake_net_quantity + stake_cpu_quantity ) * count;
+      if( total_stake.amount > 0 ) {
+         token::transfer_action transfer_act{ token_account, { {creator, active_permission} } };
+         transfer_act.send( creator, stake_account, total_stake, "stake bandwidth" );
+
+         if( !transfer ) {
+            vote_stake_updater( creator );
+            update_voting_power( creator, total_stake );
+         }
+      }
+
+      account_provision_table provisions( get_self(), get_self().value );
+      int64_t bytes_remainder = bytes_out % count;
+      for( const auto& acct : accounts ) {
+         check( provisions.find( acct.account.value ) == provisions.end(), "duplicate account name" );
+         provisions.emplace( creator, [&]( auto& p ) {
+            p.account    = acct.account;
+            p.from       = transfer ? acct.account : creator;
+            p.ram_bytes  = bytes_out / count + bytes_remainder;
+            p.net_weight = stake_net_quantity;
+            p.cpu_weight = stake_cpu_quantity;
+         });
+         bytes_remainder = 0;
+
+         eosio::action( permission_level{ creator, active_permission }, get_self(), "newaccount"_n,
+                        std::make_tuple( creator, acct.account, acct.owner, acct.active ) ).send();
+      }
+   }
+
   /**
     *  The system contract now buys and sells RAM allocations at prevailing market prices.
     *  This may result in traders buying RAM today in anticipation of potential shortages
@@ -120,26 +188,26 @@ namespace eosiosystem {
       check( res_itr->ram_bytes >= bytes, "insufficient quota" );
 
       asset tokens_out;
-      auto itr = _rammarket.find(ramcore_symbol.raw());
-      _rammarket.modify( itr, same_payer, [&]( auto& es ) {
+      auto itr = _rammarket->find(ramcore_symbol.raw());
+      _rammarket->modify( itr, same_payer, [&]( auto& es ) {
          /// the cast to int64_t of bytes is safe because we certify bytes is <= quota which is limited by prior purchases
          tokens_out = es.direct_convert( asset(bytes, ram_symbol), core_symbol());
       });
 
       check( tokens_out.amount > 1, "token amount received from selling ram is too low" );
 
-      _gstate.total_ram_bytes_reserved -= static_cast<decltype(_gstate.total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
-      _gstate.total_ram_stake          -= tokens_out.amount;
+      _gstate->total_ram_bytes_reserved -= static_cast<decltype(_gstate->total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
+      _gstate->total_ram_stake          -= tokens_out.amount;
 
       //// this shouldn't happen, but just in case it does we should prevent it
-      check( _gstate.total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
+      check( _gstate->total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
 
       userres.modify( res_itr, account, [&]( auto& res ) {
           res.ram_bytes -= bytes;
       });
 
-      auto voter_itr = _voters.find( res_itr->owner.value );
-      if( voter_itr == _voters.end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
+      auto voter_itr = _voters->find( res_itr->owner.value );
+      if( voter_itr == _voters->end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
          int64_t ram_bytes, net, cpu;
          get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
          set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
@@ -151,10 +219,9 @@ namespace eosiosystem {
       }
       auto fee = ( tokens_out.amount + 199 ) / 200; /// .5% fee (round up)
       // since tokens_out.amount was asserted to be at least 2 earlier, fee.amount < tokens_out.amount
-      if ( fee > 0 ) {
+      if ( fee > 0 && !pay_fee_to_rex( account, asset(fee, core_symbol()), "sell ram fee" ) ) {
          token::transfer_action transfer_act{ token_account, { {account, active_permission} } };
          transfer_act.send( account, ramfee_account, asset(fee, core_symbol()), "sell ram fee" );
-         channel_to_rex( ramfee_account, asset(fee, core_symbol() ));
       }
    }
 
@@ -230,8 +297,8 @@ namespace eosiosystem {
             bool net_managed = false;
             bool cpu_managed = false;
 
-            auto voter_itr = _voters.find( receiver.value );
-            if( voter_itr != _voters.end() ) {
+            auto voter_itr = _voters->find( receiver.value );
+            if( voter_itr != _voters->end() ) {
                ram_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed );
                net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
                cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
@@ -347,14 +414,14 @@ namespace eosiosystem {
 
    void system_contract::update_voting_power( const name& voter, const asset& total_update )
    {
-      auto voter_itr = _voters.find( voter.value );
-      if( voter_itr == _voters.end() ) {
-         voter_itr = _voters.emplace( voter, [&]( auto& v ) {
+      auto voter_itr = _voters->find( voter.value );
+      if( voter_itr == _voters->end() ) {
+         voter_itr = _voters->emplace( voter, [&]( auto& v ) {
             v.owner  = voter;
             v.staked = total_update.amount;
          });
       } else {
-         _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
+         _voters->modify( voter_itr, same_payer, [&]( auto& v ) {
             v.staked += total_update.amount;
          });
       }
@@ -390,7 +457,7 @@ namespace eosiosystem {
       check( unstake_cpu_quantity >= zero_asset, "must unstake a positive amount" );
       check( unstake_net_quantity >= zero_asset, "must unstake a positive amount" );
       check( unstake_cpu_quantity.amount + unstake_net_quantity.amount > 0, "must unstake a positive amount" );
-      check( _gstate.thresh_activated_stake_time != time_point(),
+      check( _gstate->thresh_activated_stake_time != time_point(),
              "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       changebw( from, receiver, -unstake_net_quantity, -unstake_cpu_quantity, false);
@@ -20,10 +20,10 @@ namespace eosiosystem {
     _voters(get_self(), get_self().value),
     _producers(get_self(), get_self().value),
     _producers2(get_self(), get_self().value),
-    _global(get_self(), get_self().value),
-    _global2(get_self(), get_self().value),
-    _global3(get_self(), get_self().value),
-    _global4(get_self(), get_self().value),
+    _gstate(get_self(), get_self().value, &get_default_parameters),
+    _gstate2(get_self(), get_self().value),
+    _gstate3(get_self(), get_self().value),
+    _gstate4(get_self(), get_self().value, &get_default_inflation_parameters),
     _rammarket(get_self(), get_self().value),
     _rexpool(get_self(), get_self().value),
     _rexretpool(get_self(), get_self().value),
@@ -32,10 +32,6 @@ namespace eosiosystem {
     _rexbalance(get_self(), get_self().value),
     _rexorders(get_self(), get_self().value)
    {
-      _gstate  = _global.exists() ? _global.get() : get_default_parameters();
-      _gstate2 = _global2.exists() ? _global2.get() : eosio_global_state2{};
-      _gstate3 = _global3.exists() ? _global3.get() : eosio_global_state3{};
-      _gstate4 = _global4.exists() ? _global4.get() : get_default_inflation_parameters();
    }
 
    eosio_global_state system_contract::get_default_parameters() {
@@ -53,60 +49,64 @@ namespace eosiosystem {
    }
 
    symbol system_contract::core_symbol()const {
-      const static auto sym = get_core_symbol( _rammarket );
-      return sym;
+      if( !_core_symbol ) {
+         core_symbol_singleton cs( get_self(), get_self().value );
+         // chains initialized before the core symbol had its own singleton keep reading rammarket until `initcoresym`
+         _core_symbol = cs.exists() ? cs.get().core : get_core_symbol( *_rammarket );
+      }
+      return *_core_symbol;
    }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, get_self() );
-      _global2.set( _gstate2, get_self() );
-      _global3.set( _gstate3, get_self() );
-      _global4.set( _gstate4, get_self() );
+      _gstate.save( get_self() );
+      _gstate2.save( get_self() );
+      _gstate3.save( get_self() );
+      _gstate4.save( get_self() );
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
       require_auth( get_self() );
 
-      check( _gstate.max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
+      check( _gstate->max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
       check( max_ram_size < 1024ll*1024*1024*1024*1024, "ram size is unrealistic" );
-      check( max_ram_size > _gstate.total_ram_bytes_reserved, "attempt to set max below reserved" );
+      check( max_ram_size > _gstate->total_ram_bytes_reserved, "attempt to set max below reserved" );
 
-      auto delta = int64_t(max_ram_size) - int64_t(_gstate.max_ram_size);
-      auto itr = _rammarket.find(ramcore_symbol.raw());
+      auto delta = int64_t(max_ram_size) - int64_t(_gstate->max_ram_size);
+      auto itr = _rammarket->find(ramcore_symbol.raw());
 
       /**
        *  Increase the amount of ram for sale based upon the change in max ram size.
        */
-      _rammarket.modify( itr, same_payer, [&]( auto& m ) {
+      _rammarket->modify( itr, same_payer, [&]( auto& m ) {
          m.base.balance.amount += delta;
       });
 
-      _gstate.max_ram_size = max_ram_size;
+      _gstate->max_ram_size = max_ram_size;
    }
 
    void system_contract::update_ram_supply() {
       auto cbt = eosio::current_block_time();
 
-      if( cbt <= _gstate2.last_ram_increase ) return;
+      if( cbt <= _gstate2->last_ram_increase ) return;
 
-      auto itr = _rammarket.find(ramcore_symbol.raw());
-      auto new_ram = (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
-      _gstate.max_ram_size += new_ram;
+      auto itr = _rammarket->find(ramcore_symbol.raw());
+      auto new_ram = (cbt.slot - _gstate2->last_ram_increase.slot)*_gstate2->new_ram_per_block;
+      _gstate->max_ram_size += new_ram;
 
       /**
        *  Increase the amount of ram for sale based upon the change in max ram size.
        */
-      _rammarket.modify( itr, same_payer, [&]( auto& m ) {
+      _rammarket->modify( itr, same_payer, [&]( auto& m ) {
          m.base.balance.amount += new_ram;
       });
-      _gstate2.last_ram_increase = cbt;
+      _gstate2->last_ram_increase = cbt;
    }
 
    void system_contract::setramrate( uint16_t bytes_per_block ) {
       require_auth( get_self() );
 
       update_ram_supply();
-      _gstate2.new_ram_per_block = bytes_per_block;
+      _gstate2->new_ram_per_block = bytes_per_block;
    }
 
 #ifdef SYSTEM_BLOCKCHAIN_PARAMETERS
@@ -115,8 +115,8 @@ namespace eosiosystem {
 
    void system_contract::setparams( const blockchain_parameters_t& params ) {
       require_auth( get_self() );
-      (eosio::blockchain_parameters&)(_gstate) = params;
-      check( 3 <= _gstate.max_authority_depth, "max_authority_depth should be at least 3" );
+      (eosio::blockchain_parameters&)(*_gstate) = params;
+      check( 3 <= _gstate->max_authority_depth, "max_authority_depth should be at least 3" );
 #ifndef SYSTEM_BLOCKCHAIN_PARAMETERS
       set_blockchain_parameters( params );
 #else
@@ -241,8 +241,8 @@ namespace eosiosystem {
       auto ritr = userres.find( account.value );
       check( ritr == userres.end(), "only supports unlimited accounts" );
 
-      auto vitr = _voters.find( account.value );
-      if( vitr != _voters.end() ) {
+      auto vitr = _voters->find( account.value );
+      if( vitr != _voters->end() ) {
          bool ram_managed = has_field( vitr->flags1, voter_info::flags1_fields::ram_managed );
          bool net_managed = has_field( vitr->flags1, voter_info::flags1_fields::net_managed );
          bool cpu_managed = has_field( vitr->flags1, voter_info::flags1_fields::cpu_managed );
@@ -261,8 +261,8 @@ namespace eosiosystem {
       int64_t ram = 0;
 
       if( !ram_bytes ) {
-         auto vitr = _voters.find( account.value );
-         check( vitr != _voters.end() && has_field( vitr->flags1, voter_info::flags1_fields::ram_managed ),
+         auto vitr = _voters->find( account.value );
+         check( vitr != _voters->end() && has_field( vitr->flags1, voter_info::flags1_fields::ram_managed ),
                 "RAM of account is already unmanaged" );
 
          user_resources_table userres( get_self(), account.value );
@@ -273,19 +273,19 @@ namespace eosiosystem {
             ram += ritr->ram_bytes;
          }
 
-         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         _voters->modify( vitr, same_payer, [&]( auto& v ) {
             v.flags1 = set_field( v.flags1, voter_info::flags1_fields::ram_managed, false );
          });
       } else {
          check( *ram_bytes >= 0, "not allowed to set RAM limit to unlimited" );
 
-         auto vitr = _voters.find( account.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         auto vitr = _voters->find( account.value );
+         if ( vitr != _voters->end() ) {
+            _voters->modify( vitr, same_payer, [&]( auto& v ) {
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::ram_managed, true );
             });
          } else {
-            _voters.emplace( account, [&]( auto& v ) {
+            _voters->emplace( account, [&]( auto& v ) {
                v.owner  = account;
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::ram_managed, true );
             });
@@ -306,8 +306,8 @@ namespace eosiosystem {
       int64_t net = 0;
 
       if( !net_weight ) {
-         auto vitr = _voters.find( account.value );
-         check( vitr != _voters.end() && has_field( vitr->flags1, voter_info::flags1_fields::net_managed ),
+         auto vitr = _voters->find( account.value );
+         check( vitr != _voters->end() && has_field( vitr->flags1, voter_info::flags1_fields::net_managed ),
                 "Network bandwidth of account is already unmanaged" );
 
          user_resources_table userres( get_self(), account.value );
@@ -317,19 +317,19 @@ namespace eosiosystem {
             net = ritr->net_weight.amount;
          }
 
-         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         _voters->modify( vitr, same_payer, [&]( auto& v ) {
             v.flags1 = set_field( v.flags1, voter_info::flags1_fields::net_managed, false );
          });
       } else {
          check( *net_weight >= -1, "invalid value for net_weight" );
 
-         auto vitr = _voters.find( account.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         auto vitr = _voters->find( account.value );
+         if ( vitr != _voters->end() ) {
+            _voters->modify( vitr, same_payer, [&]( auto& v ) {
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::net_managed, true );
             });
          } else {
-            _voters.emplace( account, [&]( auto& v ) {
+            _voters->emplace( account, [&]( auto& v ) {
                v.owner  = account;
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::net_managed, true );
             });
@@ -350,8 +350,8 @@ namespace eosiosystem {
       int64_t cpu = 0;
 
       if( !cpu_weight ) {
-         auto vitr = _voters.find( account.value );
-         check( vitr != _voters.end() && has_field( vitr->flags1, voter_info::flags1_fields::cpu_managed ),
+         auto vitr = _voters->find( account.value );
+         check( vitr != _voters->end() && has_field( vitr->flags1, voter_info::flags1_fields::cpu_managed ),
                 "CPU bandwidth of account is already unmanaged" );
 
          user_resources_table userres( get_self(), account.value );
@@ -361,19 +361,19 @@ namespace eosiosystem {
             cpu = ritr->cpu_weight.amount;
          }
 
-         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         _voters->modify( vitr, same_payer, [&]( auto& v ) {
             v.flags1 = set_field( v.flags1, voter_info::flags1_fields::cpu_managed, false );
          });
       } else {
          check( *cpu_weight >= -1, "invalid value for cpu_weight" );
 
-         auto vitr = _voters.find( account.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+         auto vitr = _voters->find( account.value );
+         if ( vitr != _voters->end() ) {
+            _voters->modify( vitr, same_payer, [&]( auto& v ) {
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::cpu_managed, true );
             });
          } else {
-            _voters.emplace( account, [&]( auto& v ) {
+            _voters->emplace( account, [&]( auto& v ) {
                v.owner  = account;
                v.flags1 = set_field( v.flags1, voter_info::flags1_fields::cpu_managed, true );
             });
@@ -392,20 +392,20 @@ namespace eosiosystem {
 
    void system_contract::rmvproducer( const name& producer ) {
       require_auth( get_self() );
-      auto prod = _producers.find( producer.value );
-      check( prod != _producers.end(), "producer not found" );
-      _producers.modify( prod, same_payer, [&](auto& p) {
+      auto prod = _producers->find( producer.value );
+      check( prod != _producers->end(), "producer not found" );
+      _producers->modify( prod, same_payer, [&](auto& p) {
             p.deactivate();
          });
    }
 
    void system_contract::updtrevision( uint8_t revision ) {
       require_auth( get_self() );
-      check( _gstate2.revision < 255, "can not increment revision" ); // prevent wrap around
-      check( revision == _gstate2.revision + 1, "can only increment revision by one" );
+      check( _gstate2->revision < 255, "can not increment revision" ); // prevent wrap around
+      check( revision == _gstate2->revision + 1, "can only increment revision by one" );
       check( revision <= 1, // set upper bound to greatest revision supported in the code
              "specified revision is not yet supported by the code" );
-      _gstate2.revision = revision;
+      _gstate2->revision = revision;
    }
 
    void system_contract::setinflation( int64_t annual_rate, int64_t inflation_pay_factor, int64_t votepay_factor ) {
@@ -417,10 +417,28 @@ namespace eosiosystem {
       if ( votepay_factor < pay_factor_precision ) {
          check( false, "votepay_factor must not be less than " + std::to_string(pay_factor_precision) );
       }
-      _gstate4.continuous_rate      = get_continuous_rate(annual_rate);
-      _gstate4.inflation_pay_factor = inflation_pay_factor;
-      _gstate4.votepay_factor       = votepay_factor;
-      _global4.set( _gstate4, get_self() );
+      _gstate4->continuous_rate      = get_continuous_rate(annual_rate);
+      _gstate4->inflation_pay_factor = inflation_pay_factor;
+      _gstate4->votepay_factor       = votepay_factor;
+      _gstate4.save( get_self() );
+   }
+
+   void system_contract::setlatency( const std::vector<uint16_t>& locations, const std::vector<uint32_t>& latencies ) {
+      require_auth( get_self() );
+
+      location_latency_singleton latency_table( get_self(), get_self().value );
+      if( locations.empty() ) {
+         check( latencies.empty(), "latencies must be empty when no locations are given" );
+         latency_table.remove();
+         return;
+      }
+      check( locations.size() <= location_latency::max_locations, "too many locations" );
+      for( size_t i = 1; i < locations.size(); ++i ) {
+         check( locations[i-1] < locations[i], "locations must be unique and sorted" );
+      }
+      check( uint64_t( latencies.size() ) == uint64_t( locations.size() ) * locations.size(),
+             "latencies must hold one entry per pair of locations" );
+      latency_table.set( location_latency{ locations, latencies }, get_self() );
    }
 
    /**
@@ -448,12 +466,16 @@ namespace eosiosystem {
          if( has_dot ) { // or is less than 12 characters
             auto suffix = new_account_name.suffix();
             if( suffix == new_account_name ) {
+#ifdef SYSTEM_NAME_BIDDING
                name_bid_table bids(get_self(), get_self().value);
                auto current = bids.find( new_account_name.value );
                check( current != bids.end(), "no active bid for name" );
                check( current->high_bidder == creator, "only highest bidder can claim" );
                check( current->high_bid < 0, "auction for name is not closed yet" );
                bids.erase( current );
+#else
+               check( false, "name bidding is disabled, only the system account may create premium names" );
+#endif
             } else {
                check( creator == suffix, "only suffix may create this account" );
             }
@@ -461,54 +483,120 @@ namespace eosiosystem {
       }
 
       user_resources_table  userres( get_self(), new_account_name.value );
+      account_provision_table provisions( get_self(), get_self().value );
+      auto prov = provisions.find( new_account_name.value );
+
+      if( prov == provisions.end() ) {
+         userres.emplace( new_account_name, [&]( auto& res ) {
+           res.owner = new_account_name;
+           res.net_weight = asset( 0, system_contract::get_core_symbol() );
+           res.cpu_weight = asset( 0, system_contract::get_core_symbol() );
+         });
+
+         set_resource_limits( new_account_name, 0, 0, 0 );
+         return;
+      }
 
+      // account created by `newaccounts`, apply its RAM and stake in a single step
       userres.emplace( new_account_name, [&]( auto& res ) {
         res.owner = new_account_name;
-        res.net_weight = asset( 0, system_contract::get_core_symbol() );
-        res.cpu_weight = asset( 0, system_contract::get_core_symbol() );
+        res.net_weight = prov->net_weight;
+        res.cpu_weight = prov->cpu_weight;
+        res.ram_bytes = prov->ram_bytes;
       });
 
-      set_resource_limits( new_account_name, 0, 0, 0 );
+      if( prov->net_weight.amount > 0 || prov->cpu_weight.amount > 0 ) {
+         del_bandwidth_table del_tbl( get_self(), prov->from.value );
+         del_tbl.emplace( prov->from, [&]( auto& dbo ) {
+            dbo.from       = prov->from;
+            dbo.to         = new_account_name;
+            dbo.net_weight = prov->net_weight;
+            dbo.cpu_weight = prov->cpu_weight;
+         });
+
+         if( prov->from == new_account_name ) {
+            voters_table voters( get_self(), get_self().value );
+            voters.emplace( new_account_name, [&]( auto& v ) {
+               v.owner  = new_account_name;
+               v.staked = prov->net_weight.amount + prov->cpu_weight.amount;
+            });
+         }
+      }
+
+      set_resource_limits( new_account_name, prov->ram_bytes + ram_gift_bytes,
+                           prov->net_weight.amount, prov->cpu_weight.amount );
+      provisions.erase( prov );
    }
 
    void native::setabi( const name& acnt, const std::vector<char>& abi,
                         const binary_extension<std::string>& memo ) {
-      eosio::multi_index< "abihash"_n, abi_hash >  table(get_self(), get_self().value);
+      const auto hash = eosio::sha256( abi.data(), abi.size() );
+
+      abi_hash_table table( get_self(), get_self().value );
       auto itr = table.find( acnt.value );
       if( itr == table.end() ) {
          table.emplace( acnt, [&]( auto& row ) {
             row.owner = acnt;
-            row.hash = eosio::sha256(const_cast<char*>(abi.data()), abi.size());
+            row.hash  = hash;
          });
-      } else {
+      } else if( itr->hash != hash ) {
          table.modify( itr, same_payer, [&]( auto& row ) {
-            row.hash = eosio::sha256(const_cast<char*>(abi.data()), abi.size());
+            row.hash = hash;
          });
       }
    }
 
+   std::vector<abi_hash> system_contract::getabihashes( const std::vector<name>& accounts ) {
+      abi_hash_table table( get_self(), get_self().value );
+      std::vector<abi_hash> result;
+      result.reserve( accounts.size() );
+      for( const auto& acnt : accounts ) {
+         auto itr = table.find( acnt.value );
+         result.push_back( itr != table.end() ? *itr : abi_hash{ acnt, checksum256() } );
+      }
+      return result;
+   }
+
    void system_contract::init( unsigned_int version, const symbol& core ) {
       require_auth( get_self() );
       check( version.value == 0, "unsupported version for init action" );
 
-      auto itr = _rammarket.find(ramcore_symbol.raw());
-      check( itr == _rammarket.end(), "system contract has already been initialized" );
+      auto itr = _rammarket->find(ramcore_symbol.raw());
+      check( itr == _rammarket->end(), "system contract has already been initialized" );
 
       auto system_token_supply   = eosio::token::get_supply(token_account, core.code() );
       check( system_token_supply.symbol == core, "specified core symbol does not exist (precision mismatch)" );
 
       check( system_token_supply.amount > 0, "system token supply must be greater than 0" );
-      _rammarket.emplace( get_self(), [&]( auto& m ) {
+      _rammarket->emplace( get_self(), [&]( auto& m ) {
          m.supply.amount = 100000000000000ll;
          m.supply.symbol = ramcore_symbol;
-         m.base.balance.amount = int64_t(_gstate.free_ram());
+         m.base.balance.amount = int64_t(_gstate->free_ram());
          m.base.balance.symbol = ram_symbol;
          m.quote.balance.amount = system_token_supply.amount / 1000;
          m.quote.balance.symbol = core;
       });
 
+      // create the remaining global state rows, from here on they are only written back when modified
+      *_gstate2;
+      *_gstate3;
+      *_gstate4;
+
+      core_symbol_singleton cs( get_self(), get_self().value );
+      cs.set( core_symbol_state{ core }, get_self() );
+
       token::open_action open_act{ token_account, { {get_self(), active_permission} } };
       open_act.send( rex_account, core, get_self() );
    }
 
+   void system_contract::initcoresym() {
+      require_auth( get_self() );
+
+      core_symbol_singleton cs( get_self(), get_self().value );
+      check( !cs.exists(), "core symbol has already been recorded" );
+      check( _rammarket->find(ramcore_symbol.raw()) != _rammarket->end(), "system contract must first be initialized" );
+
+      cs.set( core_symbol_state{ get_core_symbol( *_rammarket ) }, get_self() );
+   }
+
 } /// eosio.system
@@ -3,6 +3,7 @@
 
 namespace eosiosystem {
 
+#ifdef SYSTEM_LIMIT_AUTH_CHANGES
    void system_contract::limitauthchg(const name& account, const std::vector<name>& allow_perms,
                                       const std::vector<name>& disallow_perms) {
       limit_auth_change_table table(get_self(), get_self().value);
@@ -33,6 +34,7 @@ namespace eosiosystem {
             table.erase(it);
       }
    }
+#endif
 
    void check_auth_change(name contract, name account, const binary_extension<name>& authorized_by) {
       name by(authorized_by.has_value() ? authorized_by.value().value : 0);
@@ -43,8 +43,8 @@ void system_contract::adjust_resources(name payer, name account, symbol core_sym
       bool net_managed = false;
       bool cpu_managed = false;
 
-      auto voter_itr = _voters.find(account.value);
-      if (voter_itr != _voters.end()) {
+      auto voter_itr = _voters->find(account.value);
+      if (voter_itr != _voters->end()) {
          ram_managed = has_field(voter_itr->flags1, voter_info::flags1_fields::ram_managed);
          net_managed = has_field(voter_itr->flags1, voter_info::flags1_fields::net_managed);
          cpu_managed = has_field(voter_itr->flags1, voter_info::flags1_fields::cpu_managed);
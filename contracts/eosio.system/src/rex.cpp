@@ -8,6 +8,7 @@ namespace eosiosystem {
    using eosio::token;
    using eosio::seconds;
 
+#ifdef SYSTEM_REX
    void system_contract::deposit( const name& owner, const asset& amount )
    {
       require_auth( owner );
@@ -82,7 +83,11 @@ namespace eosiosystem {
       const asset payment = from_net + from_cpu;
       // inline transfer from stake_account to rex_account
       {
+#ifdef SYSTEM_SYSTRANSFER
+         token::systransfer_action transfer_act{ token_account, { {stake_account, active_permission}, {get_self(), active_permission} } };
+#else
          token::transfer_action transfer_act{ token_account, { stake_account, active_permission } };
+#endif
          transfer_act.send( stake_account, rex_account, payment, "buy REX with staked tokens" );
       }
       const asset rex_received = add_to_rex_pool( payment );
@@ -100,16 +105,23 @@ namespace eosiosystem {
 
       runrex(2);
 
-      auto bitr = _rexbalance.require_find( from.value, "user must first buyrex" );
+      auto& account = get_rex_account( from );
+      check( account.balance != _rexbalance->end(), "user must first buyrex" );
+      auto bitr = account.balance;
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol,
              "asset must be a positive amount of (REX, 4)" );
-      process_rex_maturities( bitr );
-      check( rex.amount <= bitr->matured_rex, "insufficient available rex" );
+      rex_balance rb = *bitr;
+      migrate_rex_balance( rb );
+      process_rex_maturities( rb );
+      check( rex.amount <= rb.matured_rex, "insufficient available rex" );
 
-      const auto current_order = fill_rex_order( bitr, rex );
+      const auto current_order = fill_rex_order( rb, rex );
       if ( current_order.success && current_order.proceeds.amount == 0 ) {
          check( false, "proceeds are negligible" );
       }
+      _rexbalance->modify( bitr, same_payer, [&]( auto& row ) {
+         row = rb;
+      });
       asset pending_sell_order = update_rex_account( from, current_order.proceeds, current_order.stake_change );
       if ( !current_order.success ) {
          if ( from == "b1"_n ) {
@@ -119,24 +131,24 @@ namespace eosiosystem {
           * REX order couldn't be filled and is added to queue.
           * If account already has an open order, requested rex is added to existing order.
           */
-         auto oitr = _rexorders.find( from.value );
-         if ( oitr == _rexorders.end() ) {
-            oitr = _rexorders.emplace( from, [&]( auto& order ) {
+         auto& oitr = account.order;
+         if ( oitr == _rexorders->end() ) {
+            oitr = _rexorders->emplace( from, [&]( auto& order ) {
                order.owner         = from;
                order.rex_requested = rex;
                order.is_open       = true;
                order.proceeds      = asset( 0, core_symbol() );
                order.stake_change  = asset( 0, core_symbol() );
-               order.order_time    = current_time_point();
+               order.order_time    = get_rex_context().now;
             });
          } else {
-            _rexorders.modify( oitr, same_payer, [&]( auto& order ) {
+            _rexorders->modify( oitr, same_payer, [&]( auto& order ) {
                order.rex_requested.amount += rex.amount;
             });
          }
          pending_sell_order.amount = oitr->rex_requested.amount;
       }
-      check( pending_sell_order.amount <= bitr->matured_rex, "insufficient funds for current and scheduled orders" );
+      check( pending_sell_order.amount <= rb.matured_rex, "insufficient funds for current and scheduled orders" );
       // dummy action added so that sell order proceeds show up in action trace
       if ( current_order.success ) {
          rex_results::sellresult_action sellrex_act( rex_account, std::vector<eosio::permission_level>{ } );
@@ -148,16 +160,18 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      auto itr = _rexorders.require_find( owner.value, "no sellrex order is scheduled" );
-      check( itr->is_open, "sellrex order has been filled and cannot be canceled" );
-      _rexorders.erase( itr );
+      auto& account = get_rex_account( owner );
+      check( account.order != _rexorders->end(), "no sellrex order is scheduled" );
+      check( account.order->is_open, "sellrex order has been filled and cannot be canceled" );
+      _rexorders->erase( account.order );
+      account.order = _rexorders->end();
    }
 
    void system_contract::rentcpu( const name& from, const name& receiver, const asset& loan_payment, const asset& loan_fund )
    {
       require_auth( from );
 
-      rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
+      rex_cpu_loan2_table cpu_loans( get_self(), get_self().value );
       int64_t rented_tokens = rent_rex( cpu_loans, from, receiver, loan_payment, loan_fund );
       update_resource_limits( from, receiver, 0, rented_tokens );
    }
@@ -166,7 +180,7 @@ namespace eosiosystem {
    {
       require_auth( from );
 
-      rex_net_loan_table net_loans( get_self(), get_self().value );
+      rex_net_loan2_table net_loans( get_self(), get_self().value );
       int64_t rented_tokens = rent_rex( net_loans, from, receiver, loan_payment, loan_fund );
       update_resource_limits( from, receiver, rented_tokens, 0 );
    }
@@ -175,32 +189,164 @@ namespace eosiosystem {
    {
       require_auth( from );
 
-      rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
-      fund_rex_loan( cpu_loans, from, loan_num, payment  );
+      rex_cpu_loan2_table cpu_loans( get_self(), get_self().value );
+      rex_cpu_loan_table  legacy_loans( get_self(), get_self().value );
+      fund_rex_loan( cpu_loans, legacy_loans, from, loan_num, payment );
    }
 
    void system_contract::fundnetloan( const name& from, uint64_t loan_num, const asset& payment )
    {
       require_auth( from );
 
-      rex_net_loan_table net_loans( get_self(), get_self().value );
-      fund_rex_loan( net_loans, from, loan_num, payment );
+      rex_net_loan2_table net_loans( get_self(), get_self().value );
+      rex_net_loan_table  legacy_loans( get_self(), get_self().value );
+      fund_rex_loan( net_loans, legacy_loans, from, loan_num, payment );
    }
 
    void system_contract::defcpuloan( const name& from, uint64_t loan_num, const asset& amount )
    {
       require_auth( from );
 
-      rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
-      defund_rex_loan( cpu_loans, from, loan_num, amount );
+      rex_cpu_loan2_table cpu_loans( get_self(), get_self().value );
+      rex_cpu_loan_table  legacy_loans( get_self(), get_self().value );
+      defund_rex_loan( cpu_loans, legacy_loans, from, loan_num, amount );
    }
 
    void system_contract::defnetloan( const name& from, uint64_t loan_num, const asset& amount )
    {
       require_auth( from );
 
-      rex_net_loan_table net_loans( get_self(), get_self().value );
-      defund_rex_loan( net_loans, from, loan_num, amount );
+      rex_net_loan2_table net_loans( get_self(), get_self().value );
+      rex_net_loan_table  legacy_loans( get_self(), get_self().value );
+      defund_rex_loan( net_loans, legacy_loans, from, loan_num, amount );
+   }
+
+   void system_contract::fundloans( const name& from, const std::vector<rex_loan_amount>& cpu_loans, const std::vector<rex_loan_amount>& net_loans )
+   {
+      require_auth( from );
+
+      check( !cpu_loans.empty() || !net_loans.empty(), "no loans specified" );
+      asset total( 0, core_symbol() );
+      auto fund_loans = [&]( auto& table, auto& legacy, const std::vector<rex_loan_amount>& loans ) {
+         for ( const auto& loan : loans ) {
+            check( loan.amount.symbol == core_symbol(), "must use core token" );
+            check( 0 < loan.amount.amount, "must use positive asset amount" );
+            credit_rex_loan( table, legacy, from, loan.loan_num, loan.amount.amount );
+            total += loan.amount;
+         }
+      };
+      {
+         rex_cpu_loan2_table table( get_self(), get_self().value );
+         rex_cpu_loan_table  legacy( get_self(), get_self().value );
+         fund_loans( table, legacy, cpu_loans );
+      }
+      {
+         rex_net_loan2_table table( get_self(), get_self().value );
+         rex_net_loan_table  legacy( get_self(), get_self().value );
+         fund_loans( table, legacy, net_loans );
+      }
+      transfer_from_fund( from, total );
+   }
+
+   void system_contract::defundloans( const name& from, const std::vector<rex_loan_amount>& cpu_loans, const std::vector<rex_loan_amount>& net_loans )
+   {
+      require_auth( from );
+
+      check( !cpu_loans.empty() || !net_loans.empty(), "no loans specified" );
+      asset total( 0, core_symbol() );
+      auto defund_loans = [&]( auto& table, auto& legacy, const std::vector<rex_loan_amount>& loans ) {
+         for ( const auto& loan : loans ) {
+            check( loan.amount.symbol == core_symbol(), "must use core token" );
+            check( 0 < loan.amount.amount, "must use positive asset amount" );
+            debit_rex_loan( table, legacy, from, loan.loan_num, loan.amount.amount );
+            total += loan.amount;
+         }
+      };
+      {
+         rex_cpu_loan2_table table( get_self(), get_self().value );
+         rex_cpu_loan_table  legacy( get_self(), get_self().value );
+         defund_loans( table, legacy, cpu_loans );
+      }
+      {
+         rex_net_loan2_table table( get_self(), get_self().value );
+         rex_net_loan_table  legacy( get_self(), get_self().value );
+         defund_loans( table, legacy, net_loans );
+      }
+      transfer_to_fund( from, total );
+   }
+
+   void system_contract::autofundloan( const name& owner, bool enabled )
+   {
+      require_auth( owner );
+
+      const auto& itr = get_rex_account( owner ).fund;
+      check( itr != _rexfunds->end(), "must deposit to REX fund first" );
+      _rexfunds->modify( itr, same_payer, [&]( auto& fund ) {
+         fund.auto_fund_loans.emplace( enabled );
+      });
+   }
+
+   void system_contract::setrexoracle( uint32_t sample_interval, uint16_t num_samples )
+   {
+      require_auth( get_self() );
+
+      check( 0 < sample_interval, "sample interval must be positive" );
+      check( 0 < num_samples, "number of samples must be positive" );
+      check( num_samples <= rex_price_oracle::max_num_samples, "number of samples is too large" );
+
+      rex_price_sample_table samples( get_self(), get_self().value );
+      for ( auto itr = samples.begin(); itr != samples.end(); ) {
+         itr = samples.erase( itr );
+      }
+
+      rex_price_oracle_table oracle( get_self(), get_self().value );
+      auto itr = oracle.begin();
+      if ( itr == oracle.end() ) {
+         itr = oracle.emplace( get_self(), [&]( auto& o ) {
+            o.last_update = get_rex_context().now;
+         });
+      }
+      oracle.modify( itr, same_payer, [&]( auto& o ) {
+         o.sample_interval = sample_interval;
+         o.num_samples     = num_samples;
+         o.head            = 0;
+      });
+      put_rex_price_sample( 0, itr->last_update, itr->price_cumulative, itr->rent_cumulative );
+   }
+
+   rex_price_info system_contract::getrexprice( uint32_t window )
+   {
+      check( rex_system_initialized(), "rex system not initialized yet" );
+
+      const auto [rex_price, rent_price] = get_rex_prices( *_rexpool->begin() );
+      rex_price_info result{ rex_price, rent_price, rex_price, rent_price, 0 };
+
+      rex_price_oracle_table oracle( get_self(), get_self().value );
+      const auto itr = oracle.begin();
+      if ( itr == oracle.end() ) {
+         return result;
+      }
+
+      /// extend the cumulative prices to now at the current prices
+      const time_point_sec ct      = get_rex_context().now;
+      const uint32_t       elapsed = ct.sec_since_epoch() - itr->last_update.sec_since_epoch();
+      const double price_cumulative = itr->price_cumulative + rex_price * elapsed;
+      const double rent_cumulative  = itr->rent_cumulative + rent_price * elapsed;
+
+      /// samples are at least sample_interval apart, so the one `window / sample_interval` slots behind the
+      /// head is at least that old; if the ring buffer has not wrapped yet, slot 0 is the oldest one
+      const uint16_t back = std::min<uint32_t>( window / itr->sample_interval, itr->num_samples - 1 );
+      rex_price_sample_table samples( get_self(), get_self().value );
+      auto sample = samples.find( ( itr->head + itr->num_samples - back ) % itr->num_samples );
+      if ( sample == samples.end() ) {
+         sample = samples.find( 0 );
+      }
+      if ( sample != samples.end() && sample->time < ct ) {
+         result.twap_window     = ct.sec_since_epoch() - sample->time.sec_since_epoch();
+         result.twap_rex_price  = ( price_cumulative - sample->price_cumulative ) / result.twap_window;
+         result.twap_rent_price = ( rent_cumulative - sample->rent_cumulative ) / result.twap_window;
+      }
+      return result;
    }
 
    void system_contract::updaterex( const name& owner )
@@ -209,10 +355,11 @@ namespace eosiosystem {
 
       runrex(2);
 
-      auto itr = _rexbalance.require_find( owner.value, "account has no REX balance" );
+      auto itr = get_rex_account( owner ).balance;
+      check( itr != _rexbalance->end(), "account has no REX balance" );
       const asset init_stake = itr->vote_stake;
 
-      auto rexpool_itr = _rexpool.begin();
+      auto rexpool_itr = _rexpool->begin();
       const int64_t total_rex      = rexpool_itr->total_rex.amount;
       const int64_t total_lendable = rexpool_itr->total_lendable.amount;
       const int64_t rex_balance    = itr->rex_balance.amount;
@@ -221,12 +368,13 @@ namespace eosiosystem {
       if ( total_rex > 0 ) {
          current_stake.amount = ( uint128_t(rex_balance) * total_lendable ) / total_rex;
       }
-      _rexbalance.modify( itr, same_payer, [&]( auto& rb ) {
+      _rexbalance->modify( itr, same_payer, [&]( auto& rb ) {
          rb.vote_stake = current_stake;
+         migrate_rex_balance( rb );
+         process_rex_maturities( rb );
       });
 
       update_rex_account( owner, asset( 0, core_symbol() ), current_stake - init_stake, true );
-      process_rex_maturities( itr );
    }
 
    void system_contract::setrex( const asset& balance )
@@ -236,7 +384,7 @@ namespace eosiosystem {
       check( balance.amount > 0, "balance must be set to have a positive amount" );
       check( balance.symbol == core_symbol(), "balance symbol must be core symbol" );
       check( rex_system_initialized(), "rex system is not initialized" );
-      _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& pool ) {
+      _rexpool->modify( _rexpool->begin(), same_payer, [&]( auto& pool ) {
          pool.total_rent = balance;
       });
    }
@@ -245,7 +393,7 @@ namespace eosiosystem {
    {
       require_auth( user );
 
-      runrex( max );
+      runrex( max, true );
    }
 
    void system_contract::consolidate( const name& owner )
@@ -254,9 +402,13 @@ namespace eosiosystem {
 
       runrex(2);
 
-      auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
+      auto bitr = get_rex_account( owner ).balance;
+      check( bitr != _rexbalance->end(), "account has no REX balance" );
       asset rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
-      consolidate_rex_balance( bitr, rex_in_sell_order );
+      _rexbalance->modify( bitr, same_payer, [&]( auto& rb ) {
+         migrate_rex_balance( rb );
+         consolidate_rex_balance( rb, rex_in_sell_order );
+      });
    }
 
    void system_contract::mvtosavings( const name& owner, const asset& rex )
@@ -265,14 +417,16 @@ namespace eosiosystem {
 
       runrex(2);
 
-      auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
+      auto bitr = get_rex_account( owner ).balance;
+      check( bitr != _rexbalance->end(), "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
       const asset   rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
-      const int64_t rex_in_savings    = read_rex_savings( bitr );
+      const int64_t rex_in_savings    = read_rex_savings( *bitr );
       check( rex.amount + rex_in_sell_order.amount + rex_in_savings <= bitr->rex_balance.amount,
              "insufficient REX balance" );
-      process_rex_maturities( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+      _rexbalance->modify( bitr, same_payer, [&]( auto& rb ) {
+         migrate_rex_balance( rb );
+         process_rex_maturities( rb );
          int64_t moved_rex = 0;
          while ( !rb.rex_maturities.empty() && moved_rex < rex.amount) {
             const int64_t d_rex = std::min( rex.amount - moved_rex, rb.rex_maturities.back().second );
@@ -289,8 +443,8 @@ namespace eosiosystem {
             check( rex_in_sell_order.amount <= rb.matured_rex, "logic error in mvtosavings" );
          }
          check( moved_rex == rex.amount, "programmer error in mvtosavings" );
+         put_rex_savings( rb, rex_in_savings + rex.amount );
       });
-      put_rex_savings( bitr, rex_in_savings + rex.amount );
    }
 
    void system_contract::mvfrsavings( const name& owner, const asset& rex )
@@ -299,20 +453,17 @@ namespace eosiosystem {
 
       runrex(2);
 
-      auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
+      auto bitr = get_rex_account( owner ).balance;
+      check( bitr != _rexbalance->end(), "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
-      const int64_t rex_in_savings = read_rex_savings( bitr );
+      const int64_t rex_in_savings = read_rex_savings( *bitr );
       check( rex.amount <= rex_in_savings, "insufficient REX in savings" );
-      process_rex_maturities( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex.amount;
-         } else {
-            rb.rex_maturities.emplace_back( pair_time_point_sec_int64 { maturity, rex.amount } );
-         }
+      _rexbalance->modify( bitr, same_payer, [&]( auto& rb ) {
+         migrate_rex_balance( rb );
+         process_rex_maturities( rb );
+         put_rex_savings( rb, rex_in_savings - rex.amount );
+         add_rex_maturity( rb, rex.amount );
       });
-      put_rex_savings( bitr, rex_in_savings - rex.amount );
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
    }
 
@@ -327,31 +478,36 @@ namespace eosiosystem {
 
       /// check for any outstanding loans or rex fund
       {
-         rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
-         auto cpu_idx = cpu_loans.get_index<"byowner"_n>();
-         bool no_outstanding_cpu_loans = ( cpu_idx.find( owner.value ) == cpu_idx.end() );
+         auto has_loan = [&]( const auto& table ) {
+            auto idx = table.template get_index<"byowner"_n>();
+            return idx.find( owner.value ) != idx.end();
+         };
 
-         rex_net_loan_table net_loans( get_self(), get_self().value );
-         auto net_idx = net_loans.get_index<"byowner"_n>();
-         bool no_outstanding_net_loans = ( net_idx.find( owner.value ) == net_idx.end() );
+         bool no_outstanding_cpu_loans = !has_loan( rex_cpu_loan2_table( get_self(), get_self().value ) )
+                                      && !has_loan( rex_cpu_loan_table( get_self(), get_self().value ) );
+         bool no_outstanding_net_loans = !has_loan( rex_net_loan2_table( get_self(), get_self().value ) )
+                                      && !has_loan( rex_net_loan_table( get_self(), get_self().value ) );
 
-         auto fund_itr = _rexfunds.find( owner.value );
-         bool no_outstanding_rex_fund = ( fund_itr != _rexfunds.end() ) && ( fund_itr->balance.amount == 0 );
+         auto& fund_itr = get_rex_account( owner ).fund;
+         bool no_outstanding_rex_fund = ( fund_itr != _rexfunds->end() ) && ( fund_itr->balance.amount == 0 );
 
          if ( no_outstanding_cpu_loans && no_outstanding_net_loans && no_outstanding_rex_fund ) {
-            _rexfunds.erase( fund_itr );
+            _rexfunds->erase( fund_itr );
+            fund_itr = _rexfunds->end();
          }
       }
 
       /// check for remaining rex balance
       {
-         auto rex_itr = _rexbalance.find( owner.value );
-         if ( rex_itr != _rexbalance.end() ) {
+         auto& rex_itr = get_rex_account( owner ).balance;
+         if ( rex_itr != _rexbalance->end() ) {
             check( rex_itr->rex_balance.amount == 0, "account has remaining REX balance, must sell first");
-            _rexbalance.erase( rex_itr );
+            _rexbalance->erase( rex_itr );
+            rex_itr = _rexbalance->end();
          }
       }
    }
+#endif
 
    /**
     * @brief Updates account NET and CPU resource limits
@@ -389,8 +545,8 @@ namespace eosiosystem {
          bool net_managed = false;
          bool cpu_managed = false;
 
-         auto voter_itr = _voters.find( receiver.value );
-         if( voter_itr != _voters.end() ) {
+         auto voter_itr = _voters->find( receiver.value );
+         if( voter_itr != _voters->end() ) {
             net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
             cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
          }
@@ -420,8 +576,8 @@ namespace eosiosystem {
     */
    void system_contract::check_voting_requirement( const name& owner, const char* error_msg )const
    {
-      auto vitr = _voters.find( owner.value );
-      check( vitr != _voters.end() && ( vitr->proxy || 21 <= vitr->producers.size() ), error_msg );
+      auto vitr = _voters->find( owner.value );
+      check( vitr != _voters->end() && ( vitr->proxy || 21 <= vitr->producers.size() ), error_msg );
    }
 
    /**
@@ -435,10 +591,10 @@ namespace eosiosystem {
       if ( !rex_available() ) {
          return false;
       } else {
-         if ( _rexorders.begin() == _rexorders.end() ) {
+         if ( _rexorders->begin() == _rexorders->end() ) {
             return true; // no outstanding sellrex orders
          } else {
-            auto idx = _rexorders.get_index<"bytime"_n>();
+            auto idx = _rexorders->get_index<"bytime"_n>();
             return !idx.begin()->is_open; // no outstanding unfilled sellrex orders
          }
       }
@@ -454,7 +610,7 @@ namespace eosiosystem {
    void system_contract::add_loan_to_rex_pool( const asset& payment, int64_t rented_tokens, bool new_loan )
    {
       add_to_rex_return_pool( payment );
-      _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rt ) {
+      _rexpool->modify( _rexpool->begin(), same_payer, [&]( auto& rt ) {
          // add payment to total_rent
          rt.total_rent.amount    += payment.amount;
          // move rented_tokens from total_unlent to total_lent
@@ -472,18 +628,18 @@ namespace eosiosystem {
     *
     * @param loan - loan to be closed
     */
-   void system_contract::remove_loan_from_rex_pool( const rex_loan& loan )
+   void system_contract::remove_loan_from_rex_pool( const rex_loan2& loan )
    {
-      const auto& pool = _rexpool.begin();
+      const auto& pool = _rexpool->begin();
       const int64_t delta_total_rent = exchange_state::get_bancor_output( pool->total_unlent.amount,
                                                                           pool->total_rent.amount,
-                                                                          loan.total_staked.amount );
-      _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
+                                                                          loan.total_staked );
+      _rexpool->modify( pool, same_payer, [&]( auto& rt ) {
          // deduct calculated delta_total_rent from total_rent
          rt.total_rent.amount    -= delta_total_rent;
          // move rented tokens from total_lent to total_unlent
-         rt.total_unlent.amount  += loan.total_staked.amount;
-         rt.total_lent.amount    -= loan.total_staked.amount;
+         rt.total_unlent.amount  += loan.total_staked;
+         rt.total_lent.amount    -= loan.total_staked;
          rt.total_lendable.amount = rt.total_unlent.amount + rt.total_lent.amount;
       });
    }
@@ -492,13 +648,13 @@ namespace eosiosystem {
     * @brief Updates the fields of an existing loan that is being renewed
     */
    template <typename Index, typename Iterator>
-   int64_t system_contract::update_renewed_loan( Index& idx, const Iterator& itr, int64_t rented_tokens )
+   int64_t system_contract::update_renewed_loan( Index& idx, const Iterator& itr, int64_t rented_tokens, int64_t top_up )
    {
-      int64_t delta_stake = rented_tokens - itr->total_staked.amount;
+      int64_t delta_stake = rented_tokens - itr->total_staked;
       idx.modify ( itr, same_payer, [&]( auto& loan ) {
-         loan.total_staked.amount = rented_tokens;
-         loan.expiration         += eosio::days(30);
-         loan.balance.amount     -= loan.payment.amount;
+         loan.total_staked  = rented_tokens;
+         loan.expiration   += eosio::days(30);
+         loan.balance      += top_up - loan.payment;
       });
       return delta_stake;
    }
@@ -507,14 +663,15 @@ namespace eosiosystem {
     * @brief Performs maintenance operations on expired NET and CPU loans and sellrex orders
     *
     * @param max - maximum number of each of the three categories to be processed
+    * @param migrate_loans - whether unexpired legacy loans are moved into the compact loan tables too
     */
-   void system_contract::runrex( uint16_t max )
+   void system_contract::runrex( uint16_t max, bool migrate_loans )
    {
       check( rex_system_initialized(), "rex system not initialized yet" );
 
       update_rex_pool();
 
-      const auto& pool = _rexpool.begin();
+      const auto& pool = _rexpool->begin();
 
       auto process_expired_loan = [&]( auto& idx, const auto& itr ) -> std::pair<bool, int64_t> {
          /// update rex_pool in order to delete existing loan
@@ -524,43 +681,61 @@ namespace eosiosystem {
          /// calculate rented tokens at current price
          int64_t rented_tokens = exchange_state::get_bancor_output( pool->total_rent.amount,
                                                                     pool->total_unlent.amount,
-                                                                    itr->payment.amount );
+                                                                    itr->payment );
+         bool can_renew    = itr->payment < rented_tokens  /// loan has favorable return
+                          && rex_loans_available();       /// no pending sell orders
+         /// cover a balance shortfall from the owner REX fund if the owner opted in
+         int64_t top_up    = 0;
+         if ( can_renew && itr->balance < itr->payment ) {
+            top_up = auto_fund_loan( itr->from, itr->payment - itr->balance );
+         }
          /// conditions for loan renewal
-         bool renew_loan = itr->payment <= itr->balance        /// loan has sufficient balance
-                        && itr->payment.amount < rented_tokens /// loan has favorable return
-                        && rex_loans_available();              /// no pending sell orders
+         bool renew_loan = can_renew && itr->payment <= itr->balance + top_up; /// loan has sufficient balance
          if ( renew_loan ) {
             /// update rex_pool in order to account for renewed loan
-            add_loan_to_rex_pool( itr->payment, rented_tokens, false );
+            add_loan_to_rex_pool( asset( itr->payment, core_symbol() ), rented_tokens, false );
             /// update renewed loan fields
-            delta_stake = update_renewed_loan( idx, itr, rented_tokens );
+            delta_stake = update_renewed_loan( idx, itr, rented_tokens, top_up );
          } else {
             delete_loan = true;
-            delta_stake = -( itr->total_staked.amount );
+            delta_stake = -( itr->total_staked );
             /// refund "from" account if the closed loan balance is positive
-            if ( itr->balance.amount > 0 ) {
-               transfer_to_fund( itr->from, itr->balance );
+            if ( itr->balance > 0 ) {
+               transfer_to_fund( itr->from, asset( itr->balance, core_symbol() ) );
             }
          }
 
          return { delete_loan, delta_stake };
       };
 
+      /// move legacy loans into the compact tables, earliest expiration first. Expired loans are always moved since
+      /// they are processed next, the others only when asked to so that REX actions do not pay for the migration
+      auto migrate_legacy_loans = [&]( auto& table, auto& legacy ) {
+         auto legacy_idx = legacy.template get_index<"byexpr"_n>();
+         for ( uint16_t i = 0; i < max; ++i ) {
+            auto itr = legacy_idx.begin();
+            if ( itr == legacy_idx.end() || ( !migrate_loans && itr->expiration > get_rex_context().now ) ) break;
+            migrate_rex_loan( table, legacy, legacy.iterator_to( *itr ) );
+         }
+      };
+
       /// transfer from eosio.names to eosio.rex
       if ( pool->namebid_proceeds.amount > 0 ) {
          channel_to_rex( names_account, pool->namebid_proceeds );
-         _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
+         _rexpool->modify( pool, same_payer, [&]( auto& rt ) {
             rt.namebid_proceeds.amount = 0;
          });
       }
 
       /// process cpu loans
       {
-         rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
+         rex_cpu_loan2_table cpu_loans( get_self(), get_self().value );
+         rex_cpu_loan_table  legacy_loans( get_self(), get_self().value );
+         migrate_legacy_loans( cpu_loans, legacy_loans );
          auto cpu_idx = cpu_loans.get_index<"byexpr"_n>();
          for ( uint16_t i = 0; i < max; ++i ) {
             auto itr = cpu_idx.begin();
-            if ( itr == cpu_idx.end() || itr->expiration > current_time_point() ) break;
+            if ( itr == cpu_idx.end() || itr->expiration > get_rex_context().now ) break;
 
             auto result = process_expired_loan( cpu_idx, itr );
             if ( result.second != 0 )
@@ -573,11 +748,13 @@ namespace eosiosystem {
 
       /// process net loans
       {
-         rex_net_loan_table net_loans( get_self(), get_self().value );
+         rex_net_loan2_table net_loans( get_self(), get_self().value );
+         rex_net_loan_table  legacy_loans( get_self(), get_self().value );
+         migrate_legacy_loans( net_loans, legacy_loans );
          auto net_idx = net_loans.get_index<"byexpr"_n>();
          for ( uint16_t i = 0; i < max; ++i ) {
             auto itr = net_idx.begin();
-            if ( itr == net_idx.end() || itr->expiration > current_time_point() ) break;
+            if ( itr == net_idx.end() || itr->expiration > get_rex_context().now ) break;
 
             auto result = process_expired_loan( net_idx, itr );
             if ( result.second != 0 )
@@ -589,17 +766,21 @@ namespace eosiosystem {
       }
 
       /// process sellrex orders
-      if ( _rexorders.begin() != _rexorders.end() ) {
-         auto idx  = _rexorders.get_index<"bytime"_n>();
+      if ( _rexorders->begin() != _rexorders->end() ) {
+         auto idx  = _rexorders->get_index<"bytime"_n>();
          auto oitr = idx.begin();
          for ( uint16_t i = 0; i < max; ++i ) {
             if ( oitr == idx.end() || !oitr->is_open ) break;
             auto next = oitr;
             ++next;
-            auto bitr = _rexbalance.find( oitr->owner.value );
-            if ( bitr != _rexbalance.end() ) { // should always be true
-               auto result = fill_rex_order( bitr, oitr->rex_requested );
+            auto bitr = get_rex_account( oitr->owner ).balance;
+            if ( bitr != _rexbalance->end() ) { // should always be true
+               rex_balance rb = *bitr;
+               auto result = fill_rex_order( rb, oitr->rex_requested );
                if ( result.success ) {
+                  _rexbalance->modify( bitr, same_payer, [&]( auto& row ) {
+                     row = rb;
+                  });
                   const name order_owner = oitr->owner;
                   idx.modify( oitr, same_payer, [&]( auto& order ) {
                      order.proceeds.amount     = result.proceeds.amount;
@@ -617,23 +798,104 @@ namespace eosiosystem {
 
    }
 
+   /**
+    * @brief Returns the REX price and the rent price of a REX pool
+    */
+   std::pair<double, double> system_contract::get_rex_prices( const rex_pool& pool )
+   {
+      const double rex_price  = pool.total_rex.amount > 0 ? double(pool.total_lendable.amount) / pool.total_rex.amount : 0;
+      const double rent_price = pool.total_unlent.amount > 0 ? double(pool.total_rent.amount) / pool.total_unlent.amount : 0;
+      return { rex_price, rent_price };
+   }
+
+   /**
+    * @brief Writes a slot of the REX price samples ring buffer
+    */
+   void system_contract::put_rex_price_sample( uint16_t slot, const time_point_sec& time, double price_cumulative, double rent_cumulative )
+   {
+      rex_price_sample_table samples( get_self(), get_self().value );
+      auto write = [&]( auto& s ) {
+         s.slot             = slot;
+         s.time             = time;
+         s.price_cumulative = price_cumulative;
+         s.rent_cumulative  = rent_cumulative;
+      };
+      auto itr = samples.find( slot );
+      if ( itr == samples.end() ) {
+         samples.emplace( get_self(), write );
+      } else {
+         samples.modify( itr, same_payer, write );
+      }
+   }
+
+   /**
+    * @brief Advances the cumulative prices of the REX price oracle to the current time
+    *
+    * Runs before the REX pool is updated, so the prices accumulated since the last call are those the pool
+    * held over that period. A sample is added to the ring buffer at most once per sample interval.
+    */
+   void system_contract::update_rex_price_oracle()
+   {
+      if ( !rex_system_initialized() ) {
+         return;
+      }
+
+      const time_point_sec ct = get_rex_context().now;
+      rex_price_oracle_table oracle( get_self(), get_self().value );
+      auto itr = oracle.begin();
+      if ( itr == oracle.end() ) {
+         oracle.emplace( get_self(), [&]( auto& o ) {
+            o.last_update = ct;
+         });
+         put_rex_price_sample( 0, ct, 0, 0 );
+         return;
+      }
+      if ( ct <= itr->last_update ) {
+         return;
+      }
+
+      const auto [rex_price, rent_price] = get_rex_prices( *_rexpool->begin() );
+      const uint32_t elapsed = ct.sec_since_epoch() - itr->last_update.sec_since_epoch();
+      const double price_cumulative = itr->price_cumulative + rex_price * elapsed;
+      const double rent_cumulative  = itr->rent_cumulative + rent_price * elapsed;
+
+      rex_price_sample_table samples( get_self(), get_self().value );
+      const auto latest = samples.find( itr->head );
+      uint16_t   head   = itr->head;
+      if ( latest == samples.end() || latest->time + itr->sample_interval <= ct ) {
+         if ( latest != samples.end() ) {
+            head = ( head + 1 ) % itr->num_samples;
+         }
+         put_rex_price_sample( head, ct, price_cumulative, rent_cumulative );
+      }
+
+      oracle.modify( itr, same_payer, [&]( auto& o ) {
+         o.last_update      = ct;
+         o.price_cumulative = price_cumulative;
+         o.rent_cumulative  = rent_cumulative;
+         o.head             = head;
+      });
+   }
+
    /**
     * @brief Adds returns from the REX return pool to the REX pool
     */
    void system_contract::update_rex_pool()
    {
+      update_rex_price_oracle();
+
       auto get_elapsed_intervals = [&]( const time_point_sec& t1, const time_point_sec& t0 ) -> uint32_t {
          return ( t1.sec_since_epoch() - t0.sec_since_epoch() ) / rex_return_pool::dist_interval;
       };
 
-      const time_point_sec ct             = current_time_point();
+      const time_point_sec ct             = get_rex_context().now;
       const uint32_t       cts            = ct.sec_since_epoch();
       const time_point_sec effective_time{cts - cts % rex_return_pool::dist_interval};
 
-      const auto ret_pool_elem    = _rexretpool.begin();
-      const auto ret_buckets_elem = _rexretbuckets.begin();
+      const auto ret_pool_elem    = _rexretpool->begin();
+      const auto ret_buckets_elem = _rexretbuckets->begin();
 
-      if ( ret_pool_elem == _rexretpool.end() || effective_time <= ret_pool_elem->last_dist_time ) {
+      if ( ret_pool_elem == _rexretpool->end() || effective_time <= ret_pool_elem->last_dist_time ) {
          return;
       }
 
@@ -645,7 +907,7 @@ namespace eosiosystem {
          const bool new_return_bucket = ret_pool_elem->pending_bucket_time <= effective_time;
          int64_t        new_bucket_rate = 0;
          time_point_sec new_bucket_time = time_point_sec::min();
-         _rexretpool.modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
+         _rexretpool->modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
             if ( new_return_bucket ) {
                int64_t remainder = rp.pending_bucket_proceeds % rex_return_pool::total_intervals;
                new_bucket_rate   = ( rp.pending_bucket_proceeds - remainder ) / rex_return_pool::total_intervals;
@@ -663,7 +925,7 @@ namespace eosiosystem {
          });
 
          if ( new_return_bucket ) {
-            _rexretbuckets.modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
+            _rexretbuckets->modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
                auto iter = std::lower_bound(rb.return_buckets.begin(), rb.return_buckets.end(), new_bucket_time, [](const pair_time_point_sec_int64& bucket, time_point_sec first) {
                   return bucket.first < first;
                });
@@ -680,7 +942,7 @@ namespace eosiosystem {
       if ( ret_pool_elem->oldest_bucket_time <= time_threshold ) {
          int64_t expired_rate = 0;
          int64_t surplus      = 0;
-         _rexretbuckets.modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
+         _rexretbuckets->modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
             auto& return_buckets = rb.return_buckets;
             auto iter = return_buckets.begin();
             for (; iter != return_buckets.end() && iter->first <= time_threshold; ++iter) {
@@ -692,7 +954,7 @@ namespace eosiosystem {
             return_buckets.erase(return_buckets.begin(), iter);
          });
 
-         _rexretpool.modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
+         _rexretpool->modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
             if ( !ret_buckets_elem->return_buckets.empty() ) {
                rp.oldest_bucket_time = ret_buckets_elem->return_buckets.begin()->first;
             } else {
@@ -709,14 +971,14 @@ namespace eosiosystem {
       }
 
       if ( change_estimate > 0 && ret_pool_elem->proceeds < 0 ) {
-         _rexretpool.modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
+         _rexretpool->modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
             change_estimate += rp.proceeds;
             rp.proceeds      = 0;
          });
       }
 
       if ( change_estimate > 0 ) {
-         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& pool ) {
+         _rexpool->modify( _rexpool->begin(), same_payer, [&]( auto& pool ) {
             pool.total_unlent.amount += change_estimate;
             pool.total_lendable       = pool.total_unlent + pool.total_lent;
          });
@@ -734,7 +996,7 @@ namespace eosiosystem {
 
       transfer_from_fund( from, payment + fund );
 
-      const auto& pool = _rexpool.begin(); /// already checked that _rexpool.begin() != _rexpool.end() in rex_loans_available()
+      const auto& pool = _rexpool->begin(); /// already checked that _rexpool->begin() != _rexpool->end() in rex_loans_available()
 
       int64_t rented_tokens = exchange_state::get_bancor_output( pool->total_rent.amount,
                                                                  pool->total_unlent.amount,
@@ -745,10 +1007,10 @@ namespace eosiosystem {
       table.emplace( from, [&]( auto& c ) {
          c.from         = from;
          c.receiver     = receiver;
-         c.payment      = payment;
-         c.balance      = fund;
-         c.total_staked = asset( rented_tokens, core_symbol() );
-         c.expiration   = current_time_point() + eosio::days(30);
+         c.payment      = payment.amount;
+         c.balance      = fund.amount;
+         c.total_staked = rented_tokens;
+         c.expiration   = get_rex_context().now + eosio::days(30);
          c.loan_num     = pool->loan_num;
       });
 
@@ -767,15 +1029,17 @@ namespace eosiosystem {
     * different function to complete order processing, i.e. transfer proceeds to user REX fund and
     * update user vote weight.
     *
-    * @param bitr - iterator pointing to rex_balance database record
+    * The rex_balance passed in is a working copy; the caller writes it back when the order is filled.
+    *
+    * @param rb - working copy of the owner rex_balance record
     * @param rex - amount of rex to be sold
     *
     * @return rex_order_outcome - a struct containing success flag, order proceeds, and resultant
     * vote stake change
     */
-   rex_order_outcome system_contract::fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex )
+   rex_order_outcome system_contract::fill_rex_order( rex_balance& rb, const asset& rex )
    {
-      auto rexpool_itr = _rexpool.begin();
+      auto rexpool_itr = _rexpool->begin();
       const int64_t S0 = rexpool_itr->total_lendable.amount;
       const int64_t R0 = rexpool_itr->total_rex.amount;
       const int64_t p  = (uint128_t(rex.amount) * S0) / R0;
@@ -788,19 +1052,17 @@ namespace eosiosystem {
       const int64_t unlent_lower_bound = rexpool_itr->total_lent.amount / 10;
       const int64_t available_unlent   = rexpool_itr->total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
       if ( proceeds.amount <= available_unlent ) {
-         const int64_t init_vote_stake_amount = bitr->vote_stake.amount;
-         const int64_t current_stake_value    = ( uint128_t(bitr->rex_balance.amount) * S0 ) / R0;
-         _rexpool.modify( rexpool_itr, same_payer, [&]( auto& rt ) {
+         const int64_t init_vote_stake_amount = rb.vote_stake.amount;
+         const int64_t current_stake_value    = ( uint128_t(rb.rex_balance.amount) * S0 ) / R0;
+         _rexpool->modify( rexpool_itr, same_payer, [&]( auto& rt ) {
             rt.total_rex.amount      = R1;
             rt.total_lendable.amount = S1;
             rt.total_unlent.amount   = rt.total_lendable.amount - rt.total_lent.amount;
          });
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rb.vote_stake.amount   = current_stake_value - proceeds.amount;
-            rb.rex_balance.amount -= rex.amount;
-            rb.matured_rex        -= rex.amount;
-         });
-         stake_change.amount = bitr->vote_stake.amount - init_vote_stake_amount;
+         rb.vote_stake.amount   = current_stake_value - proceeds.amount;
+         rb.rex_balance.amount -= rex.amount;
+         rb.matured_rex        -= rex.amount;
+         stake_change.amount = rb.vote_stake.amount - init_vote_stake_amount;
          success = true;
       } else {
          proceeds.amount = 0;
@@ -809,33 +1071,114 @@ namespace eosiosystem {
       return { success, proceeds, stake_change };
    }
 
-   template <typename T>
-   void system_contract::fund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& payment  )
+   /**
+    * @brief Moves a loan from a legacy loan table into the corresponding compact loan table
+    *
+    * The migrated row keeps its loan number and stays billed to the loan creator.
+    *
+    * @param table - compact loan table receiving the loan
+    * @param legacy - legacy loan table holding the loan
+    * @param itr - iterator to the loan in the legacy table
+    *
+    * @return iterator to the loan in the compact table
+    */
+   template <typename T, typename L>
+   typename T::const_iterator system_contract::migrate_rex_loan( T& table, L& legacy, typename L::const_iterator itr )
    {
-      check( payment.symbol == core_symbol(), "must use core token" );
-      transfer_from_fund( from, payment );
-      auto itr = table.require_find( loan_num, "loan not found" );
+      auto loan = table.emplace( itr->from, [&]( auto& c ) {
+         c.from         = itr->from;
+         c.receiver     = itr->receiver;
+         c.payment      = itr->payment.amount;
+         c.balance      = itr->balance.amount;
+         c.total_staked = itr->total_staked.amount;
+         c.loan_num     = itr->loan_num;
+         c.expiration   = itr->expiration;
+      });
+      legacy.erase( itr );
+      return loan;
+   }
+
+   /**
+    * @brief Finds a loan in a compact loan table, migrating it from the legacy table if needed
+    */
+   template <typename T, typename L>
+   typename T::const_iterator system_contract::find_rex_loan( T& table, L& legacy, uint64_t loan_num )
+   {
+      auto itr = table.find( loan_num );
+      if ( itr == table.end() ) {
+         itr = migrate_rex_loan( table, legacy, legacy.require_find( loan_num, "loan not found" ) );
+      }
+      return itr;
+   }
+
+   /**
+    * @brief Adds tokens to the balance of a loan, without touching the REX fund
+    */
+   template <typename T, typename L>
+   void system_contract::credit_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, int64_t amount )
+   {
+      auto itr = find_rex_loan( table, legacy, loan_num );
       check( itr->from == from, "user must be loan creator" );
-      check( itr->expiration > current_time_point(), "loan has already expired" );
+      check( itr->expiration > get_rex_context().now, "loan has already expired" );
       table.modify( itr, same_payer, [&]( auto& loan ) {
-         loan.balance.amount += payment.amount;
+         loan.balance += amount;
       });
    }
 
-   template <typename T>
-   void system_contract::defund_rex_loan( T& table, const name& from, uint64_t loan_num, const asset& amount  )
+   /**
+    * @brief Takes tokens out of the balance of a loan, without touching the REX fund
+    */
+   template <typename T, typename L>
+   void system_contract::debit_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, int64_t amount )
    {
-      check( amount.symbol == core_symbol(), "must use core token" );
-      auto itr = table.require_find( loan_num, "loan not found" );
+      auto itr = find_rex_loan( table, legacy, loan_num );
       check( itr->from == from, "user must be loan creator" );
-      check( itr->expiration > current_time_point(), "loan has already expired" );
+      check( itr->expiration > get_rex_context().now, "loan has already expired" );
       check( itr->balance >= amount, "insufficent loan balance" );
       table.modify( itr, same_payer, [&]( auto& loan ) {
-         loan.balance.amount -= amount.amount;
+         loan.balance -= amount;
       });
+   }
+
+   template <typename T, typename L>
+   void system_contract::fund_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, const asset& payment  )
+   {
+      check( payment.symbol == core_symbol(), "must use core token" );
+      transfer_from_fund( from, payment );
+      credit_rex_loan( table, legacy, from, loan_num, payment.amount );
+   }
+
+   template <typename T, typename L>
+   void system_contract::defund_rex_loan( T& table, L& legacy, const name& from, uint64_t loan_num, const asset& amount  )
+   {
+      check( amount.symbol == core_symbol(), "must use core token" );
+      debit_rex_loan( table, legacy, from, loan_num, amount.amount );
       transfer_to_fund( from, amount );
    }
 
+   /**
+    * @brief Returns the REX fund, balance and order rows of an owner
+    *
+    * The three rows are looked up together the first time an owner is accessed and the
+    * iterators are kept for the rest of the action. Every lookup of these rows goes through
+    * here: helpers that emplace one of them store the new iterator in place, helpers that
+    * erase one reset the cached iterator to `end()`.
+    *
+    * @param owner - owner account name
+    *
+    * @return rex_account_rows& - iterators to owner rows, `end()` where a row does not exist
+    */
+   rex_account_rows& system_contract::get_rex_account( const name& owner )
+   {
+      auto itr = _rex_accounts.find( owner.value );
+      if ( itr == _rex_accounts.end() ) {
+         itr = _rex_accounts.emplace( owner.value, rex_account_rows{ _rexfunds->find( owner.value ),
+                                                                     _rexbalance->find( owner.value ),
+                                                                     _rexorders->find( owner.value ) } ).first;
+      }
+      return itr->second;
+   }
+
    /**
     * @brief Transfers tokens from owner REX fund
     *
@@ -847,13 +1190,35 @@ namespace eosiosystem {
    void system_contract::transfer_from_fund( const name& owner, const asset& amount )
    {
       check( 0 < amount.amount && amount.symbol == core_symbol(), "must transfer positive amount from REX fund" );
-      auto itr = _rexfunds.require_find( owner.value, "must deposit to REX fund first" );
+      auto itr = get_rex_account( owner ).fund;
+      check( itr != _rexfunds->end(), "must deposit to REX fund first" );
       check( amount <= itr->balance, "insufficient funds" );
-      _rexfunds.modify( itr, same_payer, [&]( auto& fund ) {
+      _rexfunds->modify( itr, same_payer, [&]( auto& fund ) {
          fund.balance.amount -= amount.amount;
       });
    }
 
+   /**
+    * @brief Covers a loan renewal shortfall from the owner REX fund
+    *
+    * Only applies if the owner opted in with `autofundloan` and the REX fund holds the full shortfall.
+    *
+    * @param owner - loan creator account
+    * @param shortfall - amount missing from the loan balance to pay for renewal
+    *
+    * @return int64_t - amount taken out of the REX fund, either 0 or `shortfall`
+    */
+   int64_t system_contract::auto_fund_loan( const name& owner, int64_t shortfall )
+   {
+      const auto& itr = get_rex_account( owner ).fund;
+      if ( itr == _rexfunds->end() || !itr->auto_fund_loans.has_value() || !itr->auto_fund_loans.value()
+           || itr->balance.amount < shortfall ) {
+         return 0;
+      }
+      transfer_from_fund( owner, asset( shortfall, core_symbol() ) );
+      return shortfall;
+   }
+
    /**
     * @brief Transfers tokens to owner REX fund
     *
@@ -863,14 +1228,14 @@ namespace eosiosystem {
    void system_contract::transfer_to_fund( const name& owner, const asset& amount )
    {
       check( 0 < amount.amount && amount.symbol == core_symbol(), "must transfer positive amount to REX fund" );
-      auto itr = _rexfunds.find( owner.value );
-      if ( itr == _rexfunds.end() ) {
-         _rexfunds.emplace( owner, [&]( auto& fund ) {
+      auto& itr = get_rex_account( owner ).fund;
+      if ( itr == _rexfunds->end() ) {
+         itr = _rexfunds->emplace( owner, [&]( auto& fund ) {
             fund.owner   = owner;
             fund.balance = amount;
          });
       } else {
-         _rexfunds.modify( itr, same_payer, [&]( auto& fund ) {
+         _rexfunds->modify( itr, same_payer, [&]( auto& fund ) {
             fund.balance.amount += amount.amount;
          });
       }
@@ -896,14 +1261,15 @@ namespace eosiosystem {
       asset to_fund( proceeds );
       asset to_stake( delta_stake );
       asset rex_in_sell_order( 0, rex_symbol );
-      auto itr = _rexorders.find( owner.value );
-      if ( itr != _rexorders.end() ) {
+      auto& itr = get_rex_account( owner ).order;
+      if ( itr != _rexorders->end() ) {
          if ( itr->is_open ) {
             rex_in_sell_order.amount = itr->rex_requested.amount;
          } else {
             to_fund.amount  += itr->proceeds.amount;
             to_stake.amount += itr->stake_change.amount;
-            _rexorders.erase( itr );
+            _rexorders->erase( itr );
+            itr = _rexorders->end();
          }
       }
 
@@ -937,6 +1303,32 @@ namespace eosiosystem {
       eosio::check( !required, "can't channel fees to rex" );
    }
 
+   /**
+    * @brief Pays a system fee straight from the payer to REX
+    *
+    * Used instead of a transfer to an intermediate system account followed by channel_to_rex,
+    * which would take two inline token transfers for the same fee.
+    *
+    * @param payer - account paying the fee
+    * @param fee - amount of the fee
+    * @param memo - memo of the transfer to rex_account
+    *
+    * @return true if the fee was paid to REX, false if fees are not channeled to REX and the
+    * caller must collect it itself
+    */
+   bool system_contract::pay_fee_to_rex( const name& payer, const asset& fee, const std::string& memo )
+   {
+#if CHANNEL_RAM_AND_NAMEBID_FEES_TO_REX
+      if ( rex_available() ) {
+         add_to_rex_return_pool( fee );
+         token::transfer_action transfer_act{ token_account, { payer, active_permission } };
+         transfer_act.send( payer, rex_account, fee, memo );
+         return true;
+      }
+#endif
+      return false;
+   }
+
    /**
     * @brief Updates namebid proceeds to be transferred to REX pool
     *
@@ -946,13 +1338,32 @@ namespace eosiosystem {
    {
 #if CHANNEL_RAM_AND_NAMEBID_FEES_TO_REX
       if ( rex_available() ) {
-         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rp ) {
+         _rexpool->modify( _rexpool->begin(), same_payer, [&]( auto& rp ) {
             rp.namebid_proceeds.amount += highest_bid;
          });
       }
 #endif
    }
 
+   /**
+    * @brief Returns the REX context of the current action, computing it on first use
+    *
+    * The context lives in the contract object, which is constructed for each action, so it can neither
+    * leak into another action nor go stale the way function-local statics would.
+    *
+    * @return rex_action_context
+    */
+   const rex_action_context& system_contract::get_rex_context()
+   {
+      if ( !_rex_context ) {
+         const uint32_t   num_of_maturity_buckets = 5;
+         const time_point now = current_time_point();
+         const uint32_t   cts = time_point_sec( now ).sec_since_epoch();
+         _rex_context.emplace( rex_action_context{ now, time_point_sec{ cts - cts % seconds_per_day + num_of_maturity_buckets * seconds_per_day } } );
+      }
+      return *_rex_context;
+   }
+
    /**
     * @brief Calculates maturity time of purchased REX tokens which is 4 days from end
     * of the day UTC
@@ -961,51 +1372,42 @@ namespace eosiosystem {
     */
    time_point_sec system_contract::get_rex_maturity()
    {
-      const uint32_t num_of_maturity_buckets = 5;
-      static const uint32_t now = current_time_point().sec_since_epoch();
-      static const uint32_t r   = now % seconds_per_day;
-      static const time_point_sec rms{ now - r + num_of_maturity_buckets * seconds_per_day };
-      return rms;
+      return get_rex_context().maturity;
    }
 
    /**
     * @brief Updates REX owner maturity buckets
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param rb - rex_balance object to be updated in memory
     */
-   void system_contract::process_rex_maturities( const rex_balance_table::const_iterator& bitr )
+   void system_contract::process_rex_maturities( rex_balance& rb )
    {
-      const time_point_sec now = current_time_point();
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         while ( !rb.rex_maturities.empty() && rb.rex_maturities.front().first <= now ) {
-            rb.matured_rex += rb.rex_maturities.front().second;
-            rb.rex_maturities.erase(rb.rex_maturities.begin());
-         }
-      });
+      const time_point_sec now = get_rex_context().now;
+      auto itr = rb.rex_maturities.begin();
+      while ( itr != rb.rex_maturities.end() && itr->first <= now ) {
+         rb.matured_rex += itr->second;
+         ++itr;
+      }
+      rb.rex_maturities.erase( rb.rex_maturities.begin(), itr );
    }
 
    /**
     * @brief Consolidates REX maturity buckets into one
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param rb - rex_balance object to be updated in memory
     * @param rex_in_sell_order - REX tokens in owner unfilled sell order, if one exists
     */
-   void system_contract::consolidate_rex_balance( const rex_balance_table::const_iterator& bitr,
-                                                  const asset& rex_in_sell_order )
+   void system_contract::consolidate_rex_balance( rex_balance& rb, const asset& rex_in_sell_order )
    {
-      const int64_t rex_in_savings = read_rex_savings( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         int64_t total  = rb.matured_rex - rex_in_sell_order.amount;
-         rb.matured_rex = rex_in_sell_order.amount;
-         while ( !rb.rex_maturities.empty() ) {
-            total += rb.rex_maturities.front().second;
-            rb.rex_maturities.erase(rb.rex_maturities.begin());
-         }
-         if ( total > 0 ) {
-            rb.rex_maturities.emplace_back( pair_time_point_sec_int64{ get_rex_maturity(), total } );
-         }
-      });
-      put_rex_savings( bitr, rex_in_savings );
+      int64_t total  = rb.matured_rex - rex_in_sell_order.amount;
+      rb.matured_rex = rex_in_sell_order.amount;
+      for ( const auto& bucket : rb.rex_maturities ) {
+         total += bucket.second;
+      }
+      rb.rex_maturities.clear();
+      if ( total > 0 ) {
+         rb.rex_maturities.emplace_back( pair_time_point_sec_int64{ get_rex_maturity(), total } );
+      }
    }
 
    /**
@@ -1028,10 +1430,10 @@ namespace eosiosystem {
       const int64_t rex_ratio = 10000;
       const asset   init_total_rent( 20'000'0000, core_symbol() ); /// base balance prevents renting profitably until at least a minimum number of core_symbol() is made available
       asset rex_received( 0, rex_symbol );
-      auto itr = _rexpool.begin();
+      auto itr = _rexpool->begin();
       if ( !rex_system_initialized() ) {
          /// initialize REX pool
-         _rexpool.emplace( get_self(), [&]( auto& rp ) {
+         _rexpool->emplace( get_self(), [&]( auto& rp ) {
             rex_received.amount = payment.amount * rex_ratio;
             rp.total_lendable   = payment;
             rp.total_lent       = asset( 0, core_symbol() );
@@ -1041,7 +1443,7 @@ namespace eosiosystem {
             rp.namebid_proceeds = asset( 0, core_symbol() );
          });
       } else if ( !rex_available() ) { /// should be a rare corner case, REX pool is initialized but empty
-         _rexpool.modify( itr, same_payer, [&]( auto& rp ) {
+         _rexpool->modify( itr, same_payer, [&]( auto& rp ) {
             rex_received.amount      = payment.amount * rex_ratio;
             rp.total_lendable.amount = payment.amount;
             rp.total_lent.amount     = 0;
@@ -1057,7 +1459,7 @@ namespace eosiosystem {
          const int64_t R0 = itr->total_rex.amount;
          const int64_t R1 = (uint128_t(S1) * R0) / S0;
          rex_received.amount = R1 - R0;
-         _rexpool.modify( itr, same_payer, [&]( auto& rp ) {
+         _rexpool->modify( itr, same_payer, [&]( auto& rp ) {
             rp.total_lendable.amount = S1;
             rp.total_rex.amount      = R1;
             rp.total_unlent.amount   = rp.total_lendable.amount - rp.total_lent.amount;
@@ -1071,30 +1473,36 @@ namespace eosiosystem {
    /**
     * @brief Adds an amount of core tokens to the REX return pool
     *
+    * Fees accumulate in the pending bucket of the return pool. Distribution of returns into the
+    * REX pool is left to runrex, which does it at most once per dist_interval; it is only run here
+    * when the pending bucket is due to be closed, so that the fee is not added to an expired bucket.
+    *
     * @param fee - amount to be added
     */
    void system_contract::add_to_rex_return_pool( const asset& fee )
    {
-      update_rex_pool();
       if ( fee.amount <= 0 ) {
          return;
       }
 
-      const time_point_sec ct              = current_time_point();
+      const time_point_sec ct              = get_rex_context().now;
       const uint32_t       cts             = ct.sec_since_epoch();
       const uint32_t       bucket_interval = rex_return_pool::hours_per_bucket * seconds_per_hour;
       const time_point_sec effective_time{cts - cts % bucket_interval + bucket_interval};
-      const auto return_pool_elem = _rexretpool.begin();
-      if ( return_pool_elem == _rexretpool.end() ) {
-         _rexretpool.emplace( get_self(), [&]( auto& rp ) {
+      const auto return_pool_elem = _rexretpool->begin();
+      if ( return_pool_elem != _rexretpool->end() && return_pool_elem->pending_bucket_time <= ct ) {
+         update_rex_pool();
+      }
+      if ( return_pool_elem == _rexretpool->end() ) {
+         _rexretpool->emplace( get_self(), [&]( auto& rp ) {
             rp.last_dist_time          = effective_time;
             rp.pending_bucket_proceeds = fee.amount;
             rp.pending_bucket_time     = effective_time;
             rp.proceeds                = fee.amount;
          });
-         _rexretbuckets.emplace( get_self(), [&]( auto& rb ) { } );
+         _rexretbuckets->emplace( get_self(), [&]( auto& rb ) { } );
       } else {
-         _rexretpool.modify( return_pool_elem, same_payer, [&]( auto& rp ) {
+         _rexretpool->modify( return_pool_elem, same_payer, [&]( auto& rp ) {
             rp.pending_bucket_proceeds += fee.amount;
             rp.proceeds                += fee.amount;
             if ( rp.pending_bucket_time == time_point_sec::maximum() ) {
@@ -1117,105 +1525,134 @@ namespace eosiosystem {
    {
       asset init_rex_stake( 0, core_symbol() );
       asset current_rex_stake( 0, core_symbol() );
-      auto bitr = _rexbalance.find( owner.value );
-      if ( bitr == _rexbalance.end() ) {
-         bitr = _rexbalance.emplace( owner, [&]( auto& rb ) {
+      auto& bitr = get_rex_account( owner ).balance;
+      if ( bitr == _rexbalance->end() ) {
+         bitr = _rexbalance->emplace( owner, [&]( auto& rb ) {
+            rb.version     = rex_balance::current_version;
             rb.owner       = owner;
             rb.vote_stake  = payment;
             rb.rex_balance = rex_received;
+            rb.rex_savings.emplace( 0 );
+            add_rex_maturity( rb, rex_received.amount );
          });
          current_rex_stake.amount = payment.amount;
       } else {
          init_rex_stake.amount = bitr->vote_stake.amount;
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+         _rexbalance->modify( bitr, same_payer, [&]( auto& rb ) {
             rb.rex_balance.amount += rex_received.amount;
-            rb.vote_stake.amount   = ( uint128_t(rb.rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
-                                     / _rexpool.begin()->total_rex.amount;
+            rb.vote_stake.amount   = ( uint128_t(rb.rex_balance.amount) * _rexpool->begin()->total_lendable.amount )
+                                     / _rexpool->begin()->total_rex.amount;
+            migrate_rex_balance( rb );
+            process_rex_maturities( rb );
+            add_rex_maturity( rb, rex_received.amount );
          });
          current_rex_stake.amount = bitr->vote_stake.amount;
       }
 
-      const int64_t rex_in_savings = read_rex_savings( bitr );
-      process_rex_maturities( bitr );
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex_received.amount;
-         } else {
-            rb.rex_maturities.emplace_back( pair_time_point_sec_int64 { maturity, rex_received.amount } );
-         }
-      });
-      put_rex_savings( bitr, rex_in_savings );
       return current_rex_stake - init_rex_stake;
    }
 
    /**
-    * @brief Reads amount of REX in savings bucket and removes the bucket from maturities
+    * @brief Migrates a rex_balance object to the current layout
     *
-    * Reads and (temporarily) removes REX savings bucket from REX maturities in order to
-    * allow uniform processing of remaining buckets as savings is a special case. This
-    * function is used in conjunction with put_rex_savings.
+    * Version 0 objects keep savings as a last maturity bucket at time_point_sec::maximum(). The bucket
+    * is moved into the rex_savings field so that all remaining buckets are regular maturities.
     *
-    * @param bitr - iterator pointing to rex_balance object
-    *
-    * @return int64_t - amount of REX in savings bucket
+    * @param rb - rex_balance object to be updated in memory
     */
-   int64_t system_contract::read_rex_savings( const rex_balance_table::const_iterator& bitr )
+   void system_contract::migrate_rex_balance( rex_balance& rb )
    {
-      int64_t rex_in_savings = 0;
-      static const time_point_sec end_of_days = time_point_sec::maximum();
-      if ( !bitr->rex_maturities.empty() && bitr->rex_maturities.back().first == end_of_days ) {
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rex_in_savings = rb.rex_maturities.back().second;
-            rb.rex_maturities.pop_back();
-         });
+      if ( rb.version >= rex_balance::current_version ) return;
+      const int64_t rex_in_savings = read_rex_savings( rb );
+      if ( rex_in_savings > 0 ) {
+         rb.rex_maturities.pop_back();
       }
-      return rex_in_savings;
+      rb.rex_savings.emplace( rex_in_savings );
+      rb.version = rex_balance::current_version;
    }
 
    /**
-    * @brief Adds a specified REX amount to savings bucket
+    * @brief Adds a specified REX amount to the bucket maturing at the current REX maturity
+    *
+    * @pre - rb has been migrated to the current layout
     *
-    * @param bitr - iterator pointing to rex_balance object
+    * @param rb - rex_balance object to be updated in memory
     * @param rex - amount of REX to be added
     */
-   void system_contract::put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex )
+   void system_contract::add_rex_maturity( rex_balance& rb, int64_t rex )
    {
-      if ( rex == 0 ) return;
-      static const time_point_sec end_of_days = time_point_sec::maximum();
-      _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == end_of_days ) {
-            rb.rex_maturities.back().second += rex;
-         } else {
-            rb.rex_maturities.emplace_back( pair_time_point_sec_int64{ end_of_days, rex } );
-         }
-      });
+      const time_point_sec maturity = get_rex_maturity();
+      if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
+         rb.rex_maturities.back().second += rex;
+      } else {
+         rb.rex_maturities.emplace_back( pair_time_point_sec_int64{ maturity, rex } );
+      }
+   }
+
+   /**
+    * @brief Reads amount of REX in savings
+    *
+    * @param rb - rex_balance object, of any version
+    *
+    * @return int64_t - amount of REX in savings
+    */
+   int64_t system_contract::read_rex_savings( const rex_balance& rb )
+   {
+      if ( rb.version >= rex_balance::current_version ) {
+         return rb.rex_savings.has_value() ? rb.rex_savings.value() : 0;
+      }
+      if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == time_point_sec::maximum() ) {
+         return rb.rex_maturities.back().second;
+      }
+      return 0;
+   }
+
+   /**
+    * @brief Sets REX savings to a specified amount
+    *
+    * @pre - rb has been migrated to the current layout
+    *
+    * @param rb - rex_balance object to be updated in memory
+    * @param rex - amount of REX to be held in savings
+    */
+   void system_contract::put_rex_savings( rex_balance& rb, int64_t rex )
+   {
+      rb.rex_savings.emplace( rex );
    }
 
    /**
     * @brief Updates voter REX vote stake to the current value of REX tokens held
     *
+    * REX appreciates every time returns are distributed, so the vote stake is only revalued once
+    * it drifts from the current value by more than 1 / rex_vote_stake_drift_divisor. Smaller drifts
+    * are carried over and picked up by the next revaluation, updaterex, or REX trade of the voter.
+    *
     * @param voter - account name of voter
     */
    void system_contract::update_rex_stake( const name& voter )
    {
       int64_t delta_stake = 0;
-      auto bitr = _rexbalance.find( voter.value );
-      if ( bitr != _rexbalance.end() && rex_available() ) {
+      auto bitr = get_rex_account( voter ).balance;
+      if ( bitr != _rexbalance->end() && rex_available() ) {
          asset init_vote_stake = bitr->vote_stake;
          asset current_vote_stake( 0, core_symbol() );
-         current_vote_stake.amount = ( uint128_t(bitr->rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
-                                     / _rexpool.begin()->total_rex.amount;
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rb.vote_stake.amount = current_vote_stake.amount;
-         });
+         current_vote_stake.amount = ( uint128_t(bitr->rex_balance.amount) * _rexpool->begin()->total_lendable.amount )
+                                     / _rexpool->begin()->total_rex.amount;
          delta_stake = current_vote_stake.amount - init_vote_stake.amount;
+         if ( std::abs( delta_stake ) * rex_vote_stake_drift_divisor <= init_vote_stake.amount ) {
+            delta_stake = 0;
+         }
+         if ( delta_stake != 0 ) {
+            _rexbalance->modify( bitr, same_payer, [&]( auto& rb ) {
+               rb.vote_stake.amount = current_vote_stake.amount;
+            });
+         }
       }
 
       if ( delta_stake != 0 ) {
-         auto vitr = _voters.find( voter.value );
-         if ( vitr != _voters.end() ) {
-            _voters.modify( vitr, same_payer, [&]( auto& vinfo ) {
+         auto vitr = _voters->find( voter.value );
+         if ( vitr != _voters->end() ) {
+            _voters->modify( vitr, same_payer, [&]( auto& vinfo ) {
                vinfo.staked += delta_stake;
             });
          }
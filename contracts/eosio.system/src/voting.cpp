@@ -14,7 +14,6 @@
 #include <limits>
 #include <set>
 #include <algorithm>
-#include <cmath>
 
 namespace eosiosystem {
 
@@ -25,7 +24,7 @@ namespace eosiosystem {
    using eosio::singleton;
 
    void system_contract::register_producer( const name& producer, const eosio::block_signing_authority& producer_authority, const std::string& url, uint16_t location ) {
-      auto prod = _producers.find( producer.value );
+      auto prod = _producers->find( producer.value );
       const auto ct = current_time_point();
 
       eosio::public_key producer_key{};
@@ -37,8 +36,8 @@ namespace eosiosystem {
          }
       }, producer_authority );
 
-      if ( prod != _producers.end() ) {
-         _producers.modify( prod, producer, [&]( producer_info& info ){
+      if ( prod != _producers->end() ) {
+         _producers->modify( prod, producer, [&]( producer_info& info ){
             info.producer_key       = producer_key;
             info.is_active          = true;
             info.url                = url;
@@ -48,17 +47,19 @@ namespace eosiosystem {
                info.last_claim_time = ct;
          });
 
-         auto prod2 = _producers2.find( producer.value );
-         if ( prod2 == _producers2.end() ) {
-            _producers2.emplace( producer, [&]( producer_info2& info ){
+         auto prod2 = _producers2->find( producer.value );
+         if ( prod2 == _producers2->end() ) {
+            const int128_t total_votes = to_fixed_vote_weight( prod->total_votes );
+            _producers2->emplace( producer, [&]( producer_info2& info ){
                info.owner                     = producer;
                info.last_votepay_share_update = ct;
+               info.set_fixed_values( 0, total_votes );
             });
-            update_total_votepay_share( ct, 0.0, prod->total_votes );
+            update_total_votepay_share( ct, 0, total_votes );
             // When introducing the producer2 table row for the first time, the producer's votes must also be accounted for in the global total_producer_votepay_share at the same time.
          }
       } else {
-         _producers.emplace( producer, [&]( producer_info& info ){
+         _producers->emplace( producer, [&]( producer_info& info ){
             info.owner              = producer;
             info.total_votes        = 0;
             info.producer_key       = producer_key;
@@ -68,9 +69,10 @@ namespace eosiosystem {
             info.last_claim_time    = ct;
             info.producer_authority.emplace( producer_authority );
          });
-         _producers2.emplace( producer, [&]( producer_info2& info ){
+         _producers2->emplace( producer, [&]( producer_info2& info ){
             info.owner                     = producer;
             info.last_votepay_share_update = ct;
+            info.set_fixed_values( 0, 0 );
          });
       }
 
@@ -97,21 +99,88 @@ namespace eosiosystem {
    void system_contract::unregprod( const name& producer ) {
       require_auth( producer );
 
-      const auto& prod = _producers.get( producer.value, "producer not found" );
-      _producers.modify( prod, same_payer, [&]( producer_info& info ){
+      const auto& prod = _producers->get( producer.value, "producer not found" );
+      _producers->modify( prod, same_payer, [&]( producer_info& info ){
          info.deactivate();
       });
    }
 
+   // Orders `producers` so that the latency from each producer to the next one, wrapping around, is low.
+   // A nearest neighbour tour is built from every producer and the tour with the lowest total latency is kept,
+   // ties going to the earlier producer so that the result only depends on the input order.
+   // Locations not covered by `latency` are treated as being as far as the farthest covered locations.
+   static void order_by_latency( std::vector<std::pair<eosio::producer_authority, uint16_t>>& producers, const location_latency& latency ) {
+      const size_t n             = producers.size();
+      const size_t num_locations = latency.locations.size();
+      if( n < 3 || num_locations == 0 || latency.latencies.empty() ) return;
+
+      const uint32_t unknown_latency = *std::max_element( latency.latencies.begin(), latency.latencies.end() );
+      std::vector<size_t> location_index( n, num_locations );
+      for( size_t i = 0; i < n; ++i ) {
+         auto itr = std::lower_bound( latency.locations.begin(), latency.locations.end(), producers[i].second );
+         if( itr != latency.locations.end() && *itr == producers[i].second ) {
+            location_index[i] = itr - latency.locations.begin();
+         }
+      }
+
+      std::vector<uint32_t> distance( n * n );
+      for( size_t i = 0; i < n; ++i ) {
+         for( size_t j = 0; j < n; ++j ) {
+            const size_t from = location_index[i], to = location_index[j];
+            distance[i * n + j] = ( from < num_locations && to < num_locations ) ? latency.latencies[from * num_locations + to]
+                                                                                  : unknown_latency;
+         }
+      }
+
+      std::vector<size_t> best_tour, tour;
+      uint64_t best_cost = std::numeric_limits<uint64_t>::max();
+      std::vector<bool> visited( n );
+      tour.reserve( n );
+      for( size_t start = 0; start < n; ++start ) {
+         std::fill( visited.begin(), visited.end(), false );
+         tour.clear();
+         tour.push_back( start );
+         visited[start] = true;
+         uint64_t cost  = 0;
+         for( size_t step = 1; step < n; ++step ) {
+            const size_t current = tour.back();
+            size_t next = n;
+            for( size_t j = 0; j < n; ++j ) {
+               if( !visited[j] && ( next == n || distance[current * n + j] < distance[current * n + next] ) ) {
+                  next = j;
+               }
+            }
+            cost += distance[current * n + next];
+            visited[next] = true;
+            tour.push_back( next );
+         }
+         cost += distance[tour.back() * n + start];
+         if( cost < best_cost ) {
+            best_cost = cost;
+            best_tour = tour;
+         }
+      }
+
+      std::vector<std::pair<eosio::producer_authority, uint16_t>> ordered;
+      ordered.reserve( n );
+      for( auto i : best_tour )
+         ordered.push_back( std::move(producers[i]) );
+      producers = std::move(ordered);
+   }
+
    void system_contract::update_elected_producers( const block_timestamp& block_time ) {
-      _gstate.last_producer_schedule_update = block_time;
+      _gstate->last_producer_schedule_update = block_time;
 
-      auto idx = _producers.get_index<"prototalvote"_n>();
+      auto idx = _producers->get_index<"prototalvote"_n>();
 
       using value_type = std::pair<eosio::producer_authority, uint16_t>;
       std::vector< value_type > top_producers;
       top_producers.reserve(21);
 
+      producer_ranking ranking;
+      ranking.last_update = block_time;
+      ranking.producers.reserve(21);
+
       for( auto it = idx.cbegin(); it != idx.cend() && top_producers.size() < 21 && 0 < it->total_votes && it->active(); ++it ) {
          top_producers.emplace_back(
             eosio::producer_authority{
@@ -120,9 +189,15 @@ namespace eosiosystem {
             },
             it->location
          );
+         ranking.producers.push_back( ranked_producer{
+            .rank        = static_cast<uint16_t>( top_producers.size() ),
+            .owner       = it->owner,
+            .total_votes = it->total_votes,
+            .location    = it->location
+         } );
       }
 
-      if( top_producers.size() == 0 || top_producers.size() < _gstate.last_producer_schedule_size ) {
+      if( top_producers.size() == 0 || top_producers.size() < _gstate->last_producer_schedule_size ) {
          return;
       }
 
@@ -131,68 +206,107 @@ namespace eosiosystem {
          // return lhs.second < rhs.second; // sort by location
       } );
 
+      location_latency_singleton latency_table( get_self(), get_self().value );
+      if( latency_table.exists() ) {
+         order_by_latency( top_producers, latency_table.get() );
+      }
+
       std::vector<eosio::producer_authority> producers;
 
       producers.reserve(top_producers.size());
       for( auto& item : top_producers )
          producers.push_back( std::move(item.first) );
 
+      // the host refuses a schedule identical to the current one, only a newly proposed schedule moves the ranking
       if( set_proposed_producers( producers ) >= 0 ) {
-         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( top_producers.size() );
+         _gstate->last_producer_schedule_size = static_cast<decltype(_gstate->last_producer_schedule_size)>( top_producers.size() );
+
+         producer_ranking_singleton ranking_table( get_self(), get_self().value );
+         ranking.epoch = ranking_table.get_or_default().epoch + 1;
+         ranking_table.set( ranking, get_self() );
       }
    }
 
-   double stake2vote( int64_t staked ) {
+   // 2^(k/52) in Q62 fixed point, for k = 0..51
+   static constexpr uint64_t pow2_week_fraction[52] = {
+      0x4000000000000000ull, 0x40dbdb538c8f4b94ull, 0x41baa9eb0c88c2dbull, 0x429c75e908b7d0f3ull,
+      0x43814992dacf602dull, 0x44692f5125040285ull, 0x455431b04b40f774ull, 0x46425b60edfd9296ull,
+      0x4733b73866b8997cull, 0x48285031461f423cull, 0x4920316bd3e58fc2ull, 0x4a1b662e9055dc9bull,
+      0x4b19f9e6b79d78f5ull, 0x4c1bf828c6dc54b7ull, 0x4d216cb102fdc33dull, 0x4e2a636401607ae9ull,
+      0x4f36e84f325407e5ull, 0x504707a96d71fec5ull, 0x515acdd37fd95159ull, 0x52724758bc523df6ull,
+      0x538d80ef8d6167a6ull, 0x54ac877a0950bc4cull, 0x55cf68068834e48dull, 0x56f62fd03bf61069ull,
+      0x5820ec3fca630b01ull, 0x594faaebe955979dull, 0x5a827999fcef3242ull, 0x5bb9663eb7f56663ull,
+      0x5cf47efebe55072bull, 0x5e33d22f49d3ada7ull, 0x5f776e56d0f6fac1ull, 0x60bf622db029347dull,
+      0x620bbc9ed522f02dull, 0x635c8cc86ca195a8ull, 0x64b1e1fc9272a252ull, 0x660bcbc203dbadfaull,
+      0x676a59d4d4674f18ull, 0x68cd9c27251f17b1ull, 0x6a35a2e1de3b00a3ull, 0x6ba27e656b4eb57aull,
+      0x6d143f4a79fd5033ull, 0x6e8af662bb3c3186ull, 0x7006b4b9a72dc03eull, 0x71878b95439cf83eull,
+      0x730d8c76ed22d094ull, 0x7498c91c22fe9eccull, 0x7629537f55aabd50ull, 0x77bf3dd8b836da5eull,
+      0x795a9a9f1471757dull, 0x7afb7c88a1ea31faull, 0x7ca1f68bdfd6c62dull, 0x7e4e1be071e470d7ull
+   };
+
+   int128_t stake2vote( int64_t staked ) {
       /// TODO subtract 2080 brings the large numbers closer to this decade
-      double weight = int64_t( (current_time_point().sec_since_epoch() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) )  / double( 52 );
-      return double(staked) * std::pow( 2, weight );
+      const int64_t weeks = int64_t( (current_time_point().sec_since_epoch() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) );
+      // staked * 2^(weeks / 52) in Q32: whole 52 week periods are a shift, the remaining weeks come from the table
+      const int128_t scaled = int128_t( staked ) * pow2_week_fraction[weeks % 52];
+      const int64_t  shift  = 62 - int64_t( vote_weight_fraction_bits ) - weeks / 52;
+      return shift >= 0 ? scaled >> shift : scaled << -shift;
    }
 
-   double system_contract::update_total_votepay_share( const time_point& ct,
-                                                       double additional_shares_delta,
-                                                       double shares_rate_delta )
+   // Votepay share accrued by holding the Q32 vote weight `rate` for `elapsed`, in integer vote weight times seconds
+   static int128_t votepay_share_delta( int128_t rate, const microseconds& elapsed ) {
+      if( rate <= 0 || elapsed.count() <= 0 ) return 0;
+      const int128_t weight = rate >> vote_weight_fraction_bits;
+      const int64_t  us     = elapsed.count();
+      return weight * (us / 1000'000) + (weight * (us % 1000'000)) / 1000'000;
+   }
+
+   int128_t system_contract::update_total_votepay_share( const time_point& ct,
+                                                         int128_t additional_shares_delta,
+                                                         int128_t shares_rate_delta )
    {
-      double delta_total_votepay_share = 0.0;
-      if( ct > _gstate3.last_vpay_state_update ) {
-         delta_total_votepay_share = _gstate3.total_vpay_share_change_rate
-                                       * double( (ct - _gstate3.last_vpay_state_update).count() / 1E6 );
+      int128_t total_votepay_share = _gstate2->get_total_producer_votepay_share();
+      int128_t total_change_rate   = _gstate3->get_total_vpay_share_change_rate();
+
+      int128_t delta_total_votepay_share = 0;
+      if( ct > _gstate3->last_vpay_state_update ) {
+         delta_total_votepay_share = votepay_share_delta( total_change_rate, ct - _gstate3->last_vpay_state_update );
       }
 
       delta_total_votepay_share += additional_shares_delta;
-      if( delta_total_votepay_share < 0 && _gstate2.total_producer_votepay_share < -delta_total_votepay_share ) {
-         _gstate2.total_producer_votepay_share = 0.0;
+      if( delta_total_votepay_share < 0 && total_votepay_share < -delta_total_votepay_share ) {
+         total_votepay_share = 0;
       } else {
-         _gstate2.total_producer_votepay_share += delta_total_votepay_share;
+         total_votepay_share += delta_total_votepay_share;
       }
 
-      if( shares_rate_delta < 0 && _gstate3.total_vpay_share_change_rate < -shares_rate_delta ) {
-         _gstate3.total_vpay_share_change_rate = 0.0;
+      if( shares_rate_delta < 0 && total_change_rate < -shares_rate_delta ) {
+         total_change_rate = 0;
       } else {
-         _gstate3.total_vpay_share_change_rate += shares_rate_delta;
+         total_change_rate += shares_rate_delta;
       }
 
-      _gstate3.last_vpay_state_update = ct;
+      _gstate2->set_total_producer_votepay_share( total_votepay_share );
+      _gstate3->set_total_vpay_share_change_rate( total_change_rate );
+      _gstate3->last_vpay_state_update = ct;
 
-      return _gstate2.total_producer_votepay_share;
+      return total_votepay_share;
    }
 
-   double system_contract::update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
-                                                          const time_point& ct,
-                                                          double shares_rate,
-                                                          bool reset_to_zero )
+   int128_t system_contract::update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
+                                                            const time_point& ct,
+                                                            int128_t shares_rate,
+                                                            int128_t total_votes,
+                                                            bool reset_to_zero )
    {
-      double delta_votepay_share = 0.0;
-      if( shares_rate > 0.0 && ct > prod_itr->last_votepay_share_update ) {
-         delta_votepay_share = shares_rate * double( (ct - prod_itr->last_votepay_share_update).count() / 1E6 ); // cannot be negative
+      int128_t delta_votepay_share = 0;
+      if( ct > prod_itr->last_votepay_share_update ) {
+         delta_votepay_share = votepay_share_delta( shares_rate, ct - prod_itr->last_votepay_share_update ); // cannot be negative
       }
 
-      double new_votepay_share = prod_itr->votepay_share + delta_votepay_share;
-      _producers2.modify( prod_itr, same_payer, [&](auto& p) {
-         if( reset_to_zero )
-            p.votepay_share = 0.0;
-         else
-            p.votepay_share = new_votepay_share;
-
+      const int128_t new_votepay_share = prod_itr->get_votepay_share() + delta_votepay_share;
+      _producers2->modify( prod_itr, same_payer, [&](auto& p) {
+         p.set_fixed_values( reset_to_zero ? 0 : new_votepay_share, total_votes );
          p.last_votepay_share_update = ct;
       } );
 
@@ -208,23 +322,23 @@ namespace eosiosystem {
 
       vote_stake_updater( voter_name );
       update_votes( voter_name, proxy, producers, true );
-      auto rex_itr = _rexbalance.find( voter_name.value );
-      if( rex_itr != _rexbalance.end() && rex_itr->rex_balance.amount > 0 ) {
+      auto rex_itr = get_rex_account( voter_name ).balance;
+      if( rex_itr != _rexbalance->end() && rex_itr->rex_balance.amount > 0 ) {
          check_voting_requirement( voter_name, "voter holding REX tokens must vote for at least 21 producers or for a proxy" );
       }
    }
 
    void system_contract::voteupdate( const name& voter_name ) {
-      auto voter = _voters.find( voter_name.value );
-      check( voter != _voters.end(), "no voter found" );
+      auto voter = _voters->find( voter_name.value );
+      check( voter != _voters->end(), "no voter found" );
 
       int64_t new_staked = 0;
       
       updaterex(voter_name);
       
       // get rex bal
-      auto rex_itr = _rexbalance.find( voter_name.value );
-      if( rex_itr != _rexbalance.end() && rex_itr->rex_balance.amount > 0 ) {
+      auto rex_itr = get_rex_account( voter_name ).balance;
+      if( rex_itr != _rexbalance->end() && rex_itr->rex_balance.amount > 0 ) {
          new_staked += rex_itr->vote_stake.amount;
       }
       del_bandwidth_table     del_tbl( get_self(), voter_name.value );
@@ -237,7 +351,7 @@ namespace eosiosystem {
 
       if( voter->staked != new_staked){
          // check if staked and new_staked are different and only
-         _voters.modify( voter, same_payer, [&]( auto& av ) {
+         _voters->modify( voter, same_payer, [&]( auto& av ) {
             av.staked = new_staked;
          });
       }
@@ -258,8 +372,8 @@ namespace eosiosystem {
          }
       }
 
-      auto voter = _voters.find( voter_name.value );
-      check( voter != _voters.end(), "user must stake before they can vote" ); /// staking creates voter object
+      auto voter = _voters->find( voter_name.value );
+      check( voter != _voters->end(), "user must stake before they can vote" ); /// staking creates voter object
       check( !proxy || !voter->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
 
       /**
@@ -267,45 +381,56 @@ namespace eosiosystem {
        * after the chain has been activated, we can use last_vote_weight to determine that this is
        * their first vote and should consider their stake activated.
        */
-      if( _gstate.thresh_activated_stake_time == time_point() && voter->last_vote_weight <= 0.0 ) {
-         _gstate.total_activated_stake += voter->staked;
-         if( _gstate.total_activated_stake >= min_activated_stake ) {
-            _gstate.thresh_activated_stake_time = current_time_point();
+      const int128_t last_vote_weight = voter->get_last_vote_weight();
+      if( _gstate->thresh_activated_stake_time == time_point() && last_vote_weight <= 0 ) {
+         _gstate->total_activated_stake += voter->staked;
+         if( _gstate->total_activated_stake >= min_activated_stake ) {
+            _gstate->thresh_activated_stake_time = current_time_point();
          }
       }
 
-      auto new_vote_weight = stake2vote( voter->staked );
+      // Refreshing an unchanged vote only needs the net weight change applied once to each producer or to the proxy,
+      // rather than removing the last vote weight and adding the new one back.
+      if( voting && last_vote_weight > 0 && proxy == voter->proxy && producers == voter->producers ) {
+         if( proxy ) {
+            const auto& current_proxy = _voters->get( proxy.value, "invalid proxy specified" );
+            check( current_proxy.is_proxy, "proxy not found" );
+         } else {
+            for( const auto& p : producers ) {
+               const auto& prod = _producers->get( p.value, ( "producer " + p.to_string() + " is not registered" ).data() );
+               check( prod.active(), ( "producer " + p.to_string() + " is not currently registered" ).data() );
+            }
+         }
+         propagate_weight_change( *voter );
+         return;
+      }
+
+      int128_t new_vote_weight = stake2vote( voter->staked );
       if( voter->is_proxy ) {
-         new_vote_weight += voter->proxied_vote_weight;
+         new_vote_weight += voter->get_proxied_vote_weight();
       }
 
-      std::map<name, std::pair<double, bool /*new*/> > producer_deltas;
-      if ( voter->last_vote_weight > 0 ) {
+      std::map<name, std::pair<int128_t, bool /*new*/> > producer_deltas;
+      if ( last_vote_weight > 0 ) {
          if( voter->proxy ) {
-            auto old_proxy = _voters.find( voter->proxy.value );
-            check( old_proxy != _voters.end(), "old proxy not found" ); //data corruption
-            _voters.modify( old_proxy, same_payer, [&]( auto& vp ) {
-                  vp.proxied_vote_weight -= voter->last_vote_weight;
-               });
-            propagate_weight_change( *old_proxy );
+            auto old_proxy = _voters->find( voter->proxy.value );
+            check( old_proxy != _voters->end(), "old proxy not found" ); //data corruption
+            propagate_weight_change( *old_proxy, -last_vote_weight );
          } else {
             for( const auto& p : voter->producers ) {
                auto& d = producer_deltas[p];
-               d.first -= voter->last_vote_weight;
+               d.first -= last_vote_weight;
                d.second = false;
             }
          }
       }
 
       if( proxy ) {
-         auto new_proxy = _voters.find( proxy.value );
-         check( new_proxy != _voters.end(), "invalid proxy specified" ); //if ( !voting ) { data corruption } else { wrong vote }
+         auto new_proxy = _voters->find( proxy.value );
+         check( new_proxy != _voters->end(), "invalid proxy specified" ); //if ( !voting ) { data corruption } else { wrong vote }
          check( !voting || new_proxy->is_proxy, "proxy not found" );
          if ( new_vote_weight >= 0 ) {
-            _voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
-                  vp.proxied_vote_weight += new_vote_weight;
-               });
-            propagate_weight_change( *new_proxy );
+            propagate_weight_change( *new_proxy, new_vote_weight );
          }
       } else {
          if( new_vote_weight >= 0 ) {
@@ -318,35 +443,37 @@ namespace eosiosystem {
       }
 
       const auto ct = current_time_point();
-      double delta_change_rate         = 0.0;
-      double total_inactive_vpay_share = 0.0;
+      int128_t delta_change_rate         = 0;
+      int128_t total_inactive_vpay_share = 0;
       for( const auto& pd : producer_deltas ) {
-         auto pitr = _producers.find( pd.first.value );
-         if( pitr != _producers.end() ) {
+         auto pitr = _producers->find( pd.first.value );
+         if( pitr != _producers->end() ) {
             if( voting && !pitr->active() && pd.second.second /* from new set */ ) {
                check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
             }
-            double init_total_votes = pitr->total_votes;
-            _producers.modify( pitr, same_payer, [&]( auto& p ) {
-               p.total_votes += pd.second.first;
-               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                  p.total_votes = 0;
-               }
-               _gstate.total_producer_vote_weight += pd.second.first;
-               //check( p.total_votes >= 0, "something bad happened" );
+            auto prod2 = _producers2->find( pd.first.value );
+            const int128_t init_total_votes = prod2 != _producers2->end() ? prod2->get_total_votes( *pitr )
+                                                                         : to_fixed_vote_weight( pitr->total_votes );
+            int128_t new_total_votes = init_total_votes + pd.second.first;
+            if ( new_total_votes < 0 ) { // tallies carried over from floating point accounting can be slightly short
+               new_total_votes = 0;
+            }
+            _producers->modify( pitr, same_payer, [&]( auto& p ) {
+               p.total_votes = to_double_vote_weight( new_total_votes );
             });
-            auto prod2 = _producers2.find( pd.first.value );
-            if( prod2 != _producers2.end() ) {
+            _gstate->set_total_producer_vote_weight( _gstate->get_total_producer_vote_weight() + pd.second.first );
+            if( prod2 != _producers2->end() ) {
                const auto last_claim_plus_3days = pitr->last_claim_time + microseconds(3 * useconds_per_day);
                bool crossed_threshold       = (last_claim_plus_3days <= ct);
                bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
                // Note: updated_after_threshold implies cross_threshold
 
-               double new_votepay_share = update_producer_votepay_share( prod2,
-                                             ct,
-                                             updated_after_threshold ? 0.0 : init_total_votes,
-                                             crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                          );
+               int128_t new_votepay_share = update_producer_votepay_share( prod2,
+                                               ct,
+                                               updated_after_threshold ? 0 : init_total_votes,
+                                               new_total_votes,
+                                               crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
+                                            );
 
                if( !crossed_threshold ) {
                   delta_change_rate += pd.second.first;
@@ -364,8 +491,8 @@ namespace eosiosystem {
 
       update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
 
-      _voters.modify( voter, same_payer, [&]( auto& av ) {
-         av.last_vote_weight = new_vote_weight;
+      _voters->modify( voter, same_payer, [&]( auto& av ) {
+         av.set_last_vote_weight( new_vote_weight );
          av.producers = producers;
          av.proxy     = proxy;
       });
@@ -374,79 +501,113 @@ namespace eosiosystem {
    void system_contract::regproxy( const name& proxy, bool isproxy ) {
       require_auth( proxy );
 
-      auto pitr = _voters.find( proxy.value );
-      if ( pitr != _voters.end() ) {
+      auto pitr = _voters->find( proxy.value );
+      if ( pitr != _voters->end() ) {
          check( isproxy != pitr->is_proxy, "action has no effect" );
          check( !isproxy || !pitr->proxy, "account that uses a proxy is not allowed to become a proxy" );
-         _voters.modify( pitr, same_payer, [&]( auto& p ) {
+         _voters->modify( pitr, same_payer, [&]( auto& p ) {
                p.is_proxy = isproxy;
             });
          propagate_weight_change( *pitr );
       } else {
-         _voters.emplace( proxy, [&]( auto& p ) {
+         _voters->emplace( proxy, [&]( auto& p ) {
                p.owner  = proxy;
                p.is_proxy = isproxy;
             });
       }
    }
 
-   void system_contract::propagate_weight_change( const voter_info& voter ) {
-      check( !voter.proxy || !voter.is_proxy, "account registered as a proxy is not allowed to use a proxy" );
-      double new_weight = stake2vote( voter.staked );
-      if ( voter.is_proxy ) {
-         new_weight += voter.proxied_vote_weight;
-      }
+   void system_contract::propagate_weight_change( const voter_info& voter, int128_t proxied_delta ) {
+      // Walks up from `voter` through its proxy, carrying the weight change forward. Each voter row is written once,
+      // together with the change of its proxied vote weight coming from the level below.
+      const voter_info* current = &voter;
+      uint32_t rows_modified = 0;
+      while( current ) {
+         check( !current->proxy || !current->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
+         const int128_t proxied_vote_weight = current->get_proxied_vote_weight() + proxied_delta;
+         int128_t new_weight = stake2vote( current->staked );
+         if ( current->is_proxy ) {
+            new_weight += proxied_vote_weight;
+         }
 
-      /// don't propagate small changes (1 ~= epsilon)
-      if ( fabs( new_weight - voter.last_vote_weight ) > 1 )  {
-         if ( voter.proxy ) {
-            auto& proxy = _voters.get( voter.proxy.value, "proxy not found" ); //data corruption
-            _voters.modify( proxy, same_payer, [&]( auto& p ) {
-                  p.proxied_vote_weight += new_weight - voter.last_vote_weight;
-               }
-            );
-            propagate_weight_change( proxy );
-         } else {
-            auto delta = new_weight - voter.last_vote_weight;
-            const auto ct = current_time_point();
-            double delta_change_rate         = 0;
-            double total_inactive_vpay_share = 0;
-            for ( auto acnt : voter.producers ) {
-               auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
-               const double init_total_votes = prod.total_votes;
-               _producers.modify( prod, same_payer, [&]( auto& p ) {
-                  p.total_votes += delta;
-                  _gstate.total_producer_vote_weight += delta;
-               });
-               auto prod2 = _producers2.find( acnt.value );
-               if ( prod2 != _producers2.end() ) {
-                  const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
-                  bool crossed_threshold       = (last_claim_plus_3days <= ct);
-                  bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-                  // Note: updated_after_threshold implies cross_threshold
-
-                  double new_votepay_share = update_producer_votepay_share( prod2,
-                                                ct,
-                                                updated_after_threshold ? 0.0 : init_total_votes,
-                                                crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                             );
-
-                  if( !crossed_threshold ) {
-                     delta_change_rate += delta;
-                  } else if( !updated_after_threshold ) {
-                     total_inactive_vpay_share += new_votepay_share;
-                     delta_change_rate -= init_total_votes;
-                  }
-               }
+         // don't propagate small changes (1 ~= epsilon); last_vote_weight keeps the weight already propagated,
+         // so small changes accumulate until they are large enough
+         const voter_info* next = nullptr;
+         const int128_t delta   = new_weight - current->get_last_vote_weight();
+         const bool propagate   = delta > vote_weight_epsilon || delta < -vote_weight_epsilon;
+         if ( propagate ) {
+            if ( current->proxy ) {
+               next = &_voters->get( current->proxy.value, "proxy not found" ); //data corruption
+            } else {
+               rows_modified += update_producer_votes( current->producers, delta );
             }
+         }
 
-            update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+         if ( propagate || proxied_delta != 0 ) {
+            _voters->modify( *current, same_payer, [&]( auto& v ) {
+                  if ( proxied_delta != 0 ) {
+                     v.set_proxied_vote_weight( proxied_vote_weight );
+                  }
+                  if ( propagate ) {
+                     v.set_last_vote_weight( new_weight );
+                  }
+               }
+            );
+            ++rows_modified;
          }
+
+         current       = next;
+         proxied_delta = delta;
       }
-      _voters.modify( voter, same_payer, [&]( auto& v ) {
-            v.last_vote_weight = new_weight;
+#ifdef SYSTEM_DEBUG_VOTE_PROPAGATION
+      eosio::print( "propagate_weight_change: ", rows_modified, " rows modified\n" );
+#endif
+   }
+
+   uint32_t system_contract::update_producer_votes( const std::vector<name>& producers, int128_t delta ) {
+      const auto ct = current_time_point();
+      uint32_t rows_modified             = 0;
+      int128_t delta_change_rate         = 0;
+      int128_t total_inactive_vpay_share = 0;
+      for ( auto acnt : producers ) {
+         auto& prod = _producers->get( acnt.value, "producer not found" ); //data corruption
+         auto prod2 = _producers2->find( acnt.value );
+         const int128_t init_total_votes = prod2 != _producers2->end() ? prod2->get_total_votes( prod )
+                                                                      : to_fixed_vote_weight( prod.total_votes );
+         int128_t new_total_votes = init_total_votes + delta;
+         if ( new_total_votes < 0 ) { // tallies carried over from floating point accounting can be slightly short
+            new_total_votes = 0;
          }
-      );
+         _producers->modify( prod, same_payer, [&]( auto& p ) {
+            p.total_votes = to_double_vote_weight( new_total_votes );
+         });
+         ++rows_modified;
+         _gstate->set_total_producer_vote_weight( _gstate->get_total_producer_vote_weight() + delta );
+         if ( prod2 != _producers2->end() ) {
+            const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
+            bool crossed_threshold       = (last_claim_plus_3days <= ct);
+            bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
+            // Note: updated_after_threshold implies cross_threshold
+
+            int128_t new_votepay_share = update_producer_votepay_share( prod2,
+                                            ct,
+                                            updated_after_threshold ? 0 : init_total_votes,
+                                            new_total_votes,
+                                            crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
+                                         );
+            ++rows_modified;
+
+            if( !crossed_threshold ) {
+               delta_change_rate += delta;
+            } else if( !updated_after_threshold ) {
+               total_inactive_vpay_share += new_votepay_share;
+               delta_change_rate -= init_total_votes;
+            }
+         }
+      }
+
+      update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      return rows_modified;
    }
 
 } /// namespace eosiosystem
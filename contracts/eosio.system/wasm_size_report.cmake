@@ -0,0 +1,11 @@
+# Prints the size of a built contract WASM together with the features it was built with.
+# Usage: cmake -DWASM_FILE=<path> -DFEATURES=<comma separated list> -P wasm_size_report.cmake
+
+file(SIZE ${WASM_FILE} WASM_SIZE)
+get_filename_component(WASM_NAME ${WASM_FILE} NAME)
+
+if(NOT FEATURES)
+  set(FEATURES "none")
+endif()
+
+message(STATUS "${WASM_NAME}: ${WASM_SIZE} bytes (features: ${FEATURES})")
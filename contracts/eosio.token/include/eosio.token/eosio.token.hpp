@@ -4,6 +4,7 @@
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -13,6 +14,17 @@ namespace eosio {
 
    using std::string;
 
+   /**
+    * One leg of a `settle` action: `quantity` moves from `from` to `to`.
+    */
+   struct settlement_leg {
+      name     from;
+      name     to;
+      asset    quantity;
+
+      EOSLIB_SERIALIZE( settlement_leg, (from)(to)(quantity) )
+   };
+
    /**
     * The `eosio.token` sample system contract defines the structures and actions that allow users to create, issue, and manage tokens for EOSIO based blockchains. It demonstrates one way to implement a smart contract which allows for creation and management of tokens. It is possible for one to create a similar contract which suits different needs. However, it is recommended that if one only needs a token with the below listed actions, that one uses the `eosio.token` contract instead of developing their own.
     * 
@@ -74,6 +86,43 @@ namespace eosio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Transfers `quantity` tokens between two system accounts (`eosio` and `eosio.*`) without notifying
+          * either of them. Meant for the system contract moving funds between its own accounts, where the
+          * notifications of `transfer` reach accounts that run no code.
+          *
+          * @param from - the system account to transfer from,
+          * @param to - the system account to be transferred to,
+          * @param quantity - the quantity of tokens to be transferred,
+          * @param memo - the memo string to accompany the transaction.
+          *
+          * @pre Requires the authority of both `eosio` and `from`; `eosio` is trusted not to send to an account
+          *      whose contract relies on being notified, as nothing on chain checks it.
+          */
+         [[eosio::action]]
+         void systransfer( const name&    from,
+                           const name&    to,
+                           const asset&   quantity,
+                           const string&  memo );
+
+         /**
+          * Settles a batch of transfers, possibly across several tokens, as one all-or-nothing action.
+          * Each token's stat row is read once, the legs are netted per account and token, and every
+          * account is written once per token and notified once, instead of once per leg.
+          *
+          * @param payer - the account paying for the RAM of balance rows created by the settlement,
+          * @param legs - the transfers to settle,
+          * @param memo - the memo string to accompany the settlement.
+          *
+          * @pre Requires the authority of `payer` and of the `from` account of every leg,
+          * @pre Each account's net outflow of a token must not exceed its balance of that token.
+          */
+         [[eosio::action]]
+         void settle( const name&                        payer,
+                      const std::vector<settlement_leg>& legs,
+                      const string&                      memo );
+
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -101,6 +150,18 @@ namespace eosio {
          [[eosio::action]]
          void close( const name& owner, const symbol& symbol );
 
+         /**
+          * Records the metadata row of a token created before that row existed, so that transfers of the
+          * token stop reading its `stat` row. Anyone may call it, once per token.
+          *
+          * @param sym - the symbol code of the token.
+          *
+          * @pre The token must exist,
+          * @pre Its metadata must not be recorded yet.
+          */
+         [[eosio::action]]
+         void initmeta( const symbol_code& sym );
+
          static asset get_supply( const name& token_contract_account, const symbol_code& sym_code )
          {
             stats statstable( token_contract_account, sym_code.raw() );
@@ -119,9 +180,15 @@ namespace eosio {
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using systransfer_action = eosio::action_wrapper<"systransfer"_n, &token::systransfer>;
+         using settle_action = eosio::action_wrapper<"settle"_n, &token::settle>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
+         using initmeta_action = eosio::action_wrapper<"initmeta"_n, &token::initmeta>;
       private:
+         // the balance keeps its full asset although the primary key repeats the symbol code: an amount plus
+         // precision byte would shrink the row data from 16 to 9 bytes, next to the 100+ bytes each row costs
+         // in the chain database, while breaking every reader of `accounts` that expects an asset
          struct [[eosio::table]] account {
             asset    balance;
 
@@ -136,11 +203,31 @@ namespace eosio {
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
 
+         // the parts of a token that never change once it is created, so that transfers read this row rather
+         // than the `stat` row rewritten by every issue and retire
+         struct [[eosio::table]] token_metadata {
+            asset    max_supply;
+            name     issuer;
+
+            uint64_t primary_key()const { return max_supply.symbol.code().raw(); }
+         };
+
          typedef eosio::multi_index< "accounts"_n, account > accounts;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
+         typedef eosio::multi_index< "tokenmeta"_n, token_metadata > metadata;
+
+         static constexpr name system_account{"eosio"_n};
+
+         static bool is_system_account( const name& account ) {
+            return account.prefix() == system_account;
+         }
 
          void sub_balance( const name& owner, const asset& value );
          void add_balance( const name& owner, const asset& value, const name& ram_payer );
+         void move_balance( const name& from, const name& to, const asset& quantity, const string& memo );
+
+         symbol get_symbol( const symbol_code& code, const char* error_msg )const;
+         void   record_metadata( const currency_stats& st );
    };
 
 }
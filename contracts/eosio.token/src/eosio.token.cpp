@@ -1,5 +1,7 @@
 #include <eosio.token/eosio.token.hpp>
 
+#include <map>
+
 namespace eosio {
 
 void token::create( const name&   issuer,
@@ -15,11 +17,12 @@ void token::create( const name&   issuer,
     auto existing = statstable.find( sym.code().raw() );
     check( existing == statstable.end(), "token with symbol already exists" );
 
-    statstable.emplace( get_self(), [&]( auto& s ) {
+    const auto& st = *statstable.emplace( get_self(), [&]( auto& s ) {
        s.supply.symbol = maximum_supply.symbol;
        s.max_supply    = maximum_supply;
        s.issuer        = issuer;
     });
+    record_metadata( st );
 }
 
 
@@ -81,16 +84,34 @@ void token::transfer( const name&    from,
     check( from != to, "cannot transfer to self" );
     require_auth( from );
     check( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( get_self(), sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
 
     require_recipient( from );
     require_recipient( to );
 
+    move_balance( from, to, quantity, memo );
+}
+
+void token::systransfer( const name&    from,
+                         const name&    to,
+                         const asset&   quantity,
+                         const string&  memo )
+{
+    check( from != to, "cannot transfer to self" );
+    require_auth( system_account );
+    require_auth( from );
+    check( is_system_account( from ) && is_system_account( to ), "only system accounts can transfer without notification" );
+    check( is_account( to ), "to account does not exist");
+
+    move_balance( from, to, quantity, memo );
+}
+
+void token::move_balance( const name& from, const name& to, const asset& quantity, const string& memo )
+{
+    const auto sym = get_symbol( quantity.symbol.code(), "unable to find key" );
+
     check( quantity.is_valid(), "invalid quantity" );
     check( quantity.amount > 0, "must transfer positive quantity" );
-    check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+    check( quantity.symbol == sym, "symbol precision mismatch" );
     check( memo.size() <= 256, "memo has more than 256 bytes" );
 
     auto payer = has_auth( to ) ? to : from;
@@ -99,6 +120,69 @@ void token::transfer( const name&    from,
     add_balance( to, quantity, payer );
 }
 
+void token::settle( const name&                        payer,
+                    const std::vector<settlement_leg>& legs,
+                    const string&                      memo )
+{
+    require_auth( payer );
+    check( !legs.empty(), "no legs to settle" );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    std::map<symbol_code, symbol> symbols;
+    std::map<std::pair<name, symbol_code>, asset> net;
+    for( const auto& leg : legs ) {
+       const auto& quantity = leg.quantity;
+       check( leg.from != leg.to, "cannot transfer to self" );
+       require_auth( leg.from );
+       check( is_account( leg.to ), "to account does not exist");
+       check( quantity.is_valid(), "invalid quantity" );
+       check( quantity.amount > 0, "must transfer positive quantity" );
+
+       const auto code = quantity.symbol.code();
+       auto sym = symbols.find( code );
+       if( sym == symbols.end() ) {
+          sym = symbols.emplace( code, get_symbol( code, "token with symbol does not exist" ) ).first;
+       }
+       check( quantity.symbol == sym->second, "symbol precision mismatch" );
+
+       net.try_emplace( { leg.from, code }, 0, quantity.symbol ).first->second -= quantity;
+       net.try_emplace( { leg.to, code }, 0, quantity.symbol ).first->second += quantity;
+
+       require_recipient( leg.from );
+       require_recipient( leg.to );
+    }
+
+    for( const auto& [key, amount] : net ) {
+       if( amount.amount < 0 ) {
+          sub_balance( key.first, -amount );
+       } else if( amount.amount > 0 ) {
+          add_balance( key.first, amount, payer );
+       }
+    }
+}
+
+symbol token::get_symbol( const symbol_code& code, const char* error_msg )const
+{
+   metadata metatable( get_self(), code.raw() );
+   const auto meta = metatable.find( code.raw() );
+   if( meta != metatable.end() ) {
+      return meta->max_supply.symbol;
+   }
+   // tokens created before the metadata row existed read the stat row until `initmeta` records it
+   stats statstable( get_self(), code.raw() );
+   return statstable.get( code.raw(), error_msg ).supply.symbol;
+}
+
+void token::record_metadata( const currency_stats& st )
+{
+   const auto code = st.supply.symbol.code();
+   metadata metatable( get_self(), code.raw() );
+   metatable.emplace( get_self(), [&]( auto& m ) {
+      m.max_supply = st.max_supply;
+      m.issuer     = st.issuer;
+   });
+}
+
 void token::sub_balance( const name& owner, const asset& value ) {
    accounts from_acnts( get_self(), owner.value );
 
@@ -132,9 +216,7 @@ void token::open( const name& owner, const symbol& symbol, const name& ram_payer
    check( is_account( owner ), "owner account does not exist" );
 
    auto sym_code_raw = symbol.code().raw();
-   stats statstable( get_self(), sym_code_raw );
-   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
-   check( st.supply.symbol == symbol, "symbol precision mismatch" );
+   check( get_symbol( symbol.code(), "symbol does not exist" ) == symbol, "symbol precision mismatch" );
 
    accounts acnts( get_self(), owner.value );
    auto it = acnts.find( sym_code_raw );
@@ -155,4 +237,17 @@ void token::close( const name& owner, const symbol& symbol )
    acnts.erase( it );
 }
 
+void token::initmeta( const symbol_code& sym )
+{
+   check( sym.is_valid(), "invalid symbol name" );
+
+   stats statstable( get_self(), sym.raw() );
+   const auto& st = statstable.get( sym.raw(), "token with symbol does not exist" );
+
+   metadata metatable( get_self(), sym.raw() );
+   check( metatable.find( sym.raw() ) == metatable.end(), "token metadata already recorded" );
+
+   record_metadata( st );
+}
+
 } /// namespace eosio
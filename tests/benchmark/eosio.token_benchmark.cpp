@@ -0,0 +1,77 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <chrono>
+#include <iostream>
+
+#include "contracts.hpp"
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace fc;
+
+using mvo = fc::mutable_variant_object;
+
+class eosio_token_benchmark : public tester {
+public:
+
+   eosio_token_benchmark() {
+      create_accounts( { "alice"_n, "eosio.token"_n } );
+      produce_blocks( 2 );
+
+      set_code( "eosio.token"_n, contracts::token_wasm() );
+      set_abi( "eosio.token"_n, contracts::token_abi().data() );
+      produce_blocks();
+   }
+
+   void token_action( account_name signer, action_name act, const variant_object& data ) {
+      base_tester::push_action( "eosio.token"_n, act, signer, data );
+   }
+
+   void transfer( account_name from, account_name to, const string& quantity, const string& memo ) {
+      token_action( from, "transfer"_n, mvo()( "from", from )( "to", to )( "quantity", quantity )( "memo", memo ) );
+   }
+};
+
+BOOST_AUTO_TEST_SUITE(eosio_token_benchmark_tests)
+
+// Many senders each transfer to a different receiver in every block, the way independent users of a
+// token do. Every transfer reads the token's metadata row and writes only the sender's and receiver's
+// balances, so none of them touches a row shared with the others.
+BOOST_FIXTURE_TEST_CASE( transfer_throughput, eosio_token_benchmark ) try {
+   const uint32_t num_senders = 100;
+   const uint32_t num_blocks  = 50;
+
+   std::vector<account_name> senders;
+   for( uint32_t i = 0; i < num_senders; ++i ) {
+      senders.emplace_back( std::string("sender") + char('a' + i / 26) + char('a' + i % 26) );
+   }
+   create_accounts( senders );
+   token_action( "eosio.token"_n, "create"_n, mvo()( "issuer", "alice" )( "maximum_supply", "1000000000.0000 CERO" ) );
+   token_action( "alice"_n, "issue"_n, mvo()( "to", "alice" )( "quantity", "1000000000.0000 CERO" )( "memo", "" ) );
+   for( const auto& s : senders ) {
+      transfer( "alice"_n, s, "1000.0000 CERO", "fund" );
+   }
+   produce_block();
+
+   std::chrono::nanoseconds elapsed{0};
+   for( uint32_t b = 0; b < num_blocks; ++b ) {
+      const auto start = std::chrono::steady_clock::now();
+      for( uint32_t i = 0; i < num_senders; ++i ) {
+         // a ring shifted by the block number, so every sender pays a different receiver in each block
+         transfer( senders[i], senders[(i + 1 + b % (num_senders - 1)) % num_senders], "0.0001 CERO", std::to_string(b) );
+      }
+      elapsed += std::chrono::steady_clock::now() - start;
+      produce_block();
+   }
+
+   const uint64_t count   = uint64_t(num_senders) * num_blocks;
+   const double   seconds = std::chrono::duration<double>( elapsed ).count();
+   std::cout << "eosio.token transfer throughput: " << count << " transfers from " << num_senders << " senders in "
+             << seconds << " s, " << uint64_t( count / seconds ) << " transfers/sec" << std::endl;
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,170 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include "contracts.hpp"
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace fc;
+
+using mvo = fc::mutable_variant_object;
+
+class eosio_bios_tester : public tester {
+public:
+
+   // only PREACTIVATE_FEATURE is active, so the bios contract under test can activate the others
+   eosio_bios_tester() : tester( setup_policy::preactivate_feature_and_new_bios ) {
+      // the bios contract proposes producer authorities, which needs WTMSIG_BLOCK_SIGNATURES
+      preactivate_builtin_protocol_features( { builtin_protocol_feature_t::wtmsig_block_signatures } );
+      produce_block();
+
+      set_code( config::system_account_name, contracts::bios_wasm() );
+      set_abi( config::system_account_name, contracts::bios_abi().data() );
+      produce_block();
+   }
+
+   digest_type builtin_digest( builtin_protocol_feature_t f ) const {
+      return *control->get_protocol_feature_manager().get_builtin_digest( f );
+   }
+
+   bool is_activated( builtin_protocol_feature_t f ) const {
+      return control->is_builtin_activated( f );
+   }
+
+   transaction_trace_ptr activatemany( const std::vector<digest_type>& digests, name actor = config::system_account_name ) {
+      return push_action( config::system_account_name, "activatemany"_n, actor, mvo()( "feature_digests", digests ) );
+   }
+
+   fc::variant genesis_account( name account, bool is_priv, int64_t ram_bytes, int64_t net_weight, int64_t cpu_weight ) {
+      return mvo()
+         ( "account",    account )
+         ( "owner",      authority( get_public_key( account, "owner" ) ) )
+         ( "active",     authority( get_public_key( account, "active" ) ) )
+         ( "is_priv",    is_priv )
+         ( "ram_bytes",  ram_bytes )
+         ( "net_weight", net_weight )
+         ( "cpu_weight", cpu_weight );
+   }
+
+   transaction_trace_ptr genesis( const fc::variants& accounts, const fc::variants& producers = {} ) {
+      return push_action( config::system_account_name, "genesis"_n, config::system_account_name,
+                          mvo()( "plan", mvo()( "accounts", accounts )( "producers", producers ) ) );
+   }
+
+   bool is_privileged( name account ) const {
+      return control->db().get<account_metadata_object, by_name>( account ).is_privileged();
+   }
+};
+
+BOOST_AUTO_TEST_SUITE(eosio_bios_tests)
+
+BOOST_FIXTURE_TEST_CASE( activatemany_test, eosio_bios_tester ) try {
+   const std::vector<digest_type> digests = {
+      builtin_digest( builtin_protocol_feature_t::only_link_to_existing_permission ),
+      builtin_digest( builtin_protocol_feature_t::fix_linkauth_restriction )
+   };
+   BOOST_REQUIRE( !is_activated( builtin_protocol_feature_t::only_link_to_existing_permission ) );
+   BOOST_REQUIRE( !is_activated( builtin_protocol_feature_t::fix_linkauth_restriction ) );
+
+   create_account( "bob"_n );
+   BOOST_REQUIRE_THROW( activatemany( digests, "bob"_n ), missing_auth_exception );
+
+   activatemany( digests );
+   produce_block();
+   BOOST_REQUIRE( is_activated( builtin_protocol_feature_t::only_link_to_existing_permission ) );
+   BOOST_REQUIRE( is_activated( builtin_protocol_feature_t::fix_linkauth_restriction ) );
+
+   // the whole list is rejected if any digest cannot be preactivated
+   const std::vector<digest_type> mixed = {
+      builtin_digest( builtin_protocol_feature_t::disallow_empty_producer_schedule ),
+      builtin_digest( builtin_protocol_feature_t::fix_linkauth_restriction )
+   };
+   BOOST_REQUIRE_THROW( activatemany( mixed ), protocol_feature_exception );
+   produce_block();
+   BOOST_REQUIRE( !is_activated( builtin_protocol_feature_t::disallow_empty_producer_schedule ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( genesis_test, eosio_bios_tester ) try {
+   const name alice = "alice"_n;
+   const name bob   = "bob"_n;
+
+   BOOST_REQUIRE_EQUAL( false, control->db().find<account_object, by_name>( alice ) != nullptr );
+
+   genesis( { genesis_account( alice, true,  1024 * 1024, 200, 300 ),
+              genesis_account( bob,   false, -1,          -1,  -1 ) } );
+   produce_block();
+
+   BOOST_REQUIRE( control->db().find<account_object, by_name>( alice ) != nullptr );
+   BOOST_REQUIRE( control->db().find<account_object, by_name>( bob ) != nullptr );
+   BOOST_REQUIRE_EQUAL( true,  is_privileged( alice ) );
+   BOOST_REQUIRE_EQUAL( false, is_privileged( bob ) );
+
+   int64_t ram_bytes = 0, net_weight = 0, cpu_weight = 0;
+   control->get_resource_limits_manager().get_account_limits( alice, ram_bytes, net_weight, cpu_weight );
+   BOOST_REQUIRE_EQUAL( 1024 * 1024, ram_bytes );
+   BOOST_REQUIRE_EQUAL( 200,         net_weight );
+   BOOST_REQUIRE_EQUAL( 300,         cpu_weight );
+
+   // the created account is controlled by the keys of the plan
+   set_code( alice, contracts::bios_wasm() );
+
+   // existing accounts are set to the plan, which revokes the privilege of alice
+   genesis( { genesis_account( alice, false, 2 * 1024 * 1024, 400, 600 ) } );
+   BOOST_REQUIRE_EQUAL( false, is_privileged( alice ) );
+   control->get_resource_limits_manager().get_account_limits( alice, ram_bytes, net_weight, cpu_weight );
+   BOOST_REQUIRE_EQUAL( 2 * 1024 * 1024, ram_bytes );
+   BOOST_REQUIRE_EQUAL( 400,             net_weight );
+   BOOST_REQUIRE_EQUAL( 600,             cpu_weight );
+
+   // and limits left at -1 make them unlimited
+   genesis( { genesis_account( alice, true, -1, -1, -1 ) } );
+   BOOST_REQUIRE_EQUAL( true, is_privileged( alice ) );
+   control->get_resource_limits_manager().get_account_limits( alice, ram_bytes, net_weight, cpu_weight );
+   BOOST_REQUIRE_EQUAL( -1, ram_bytes );
+   BOOST_REQUIRE_EQUAL( -1, net_weight );
+   BOOST_REQUIRE_EQUAL( -1, cpu_weight );
+
+   const name carol = "carol"_n;
+   BOOST_REQUIRE_EXCEPTION( genesis( { genesis_account( carol, false, -1, -1, -1 ),
+                                       genesis_account( carol, true,  -1, -1, -1 ) } ),
+                            eosio_assert_message_exception, eosio_assert_message_is( "duplicate account in genesis plan" ) );
+   BOOST_REQUIRE( control->db().find<account_object, by_name>( carol ) == nullptr );
+
+   BOOST_REQUIRE_EXCEPTION( genesis( {} ),
+                            eosio_assert_message_exception, eosio_assert_message_is( "genesis plan is empty" ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( genesis_producers_test, eosio_bios_tester ) try {
+   const name alice = "alice"_n;
+   const name bob   = "bob"_n;
+
+   // producers must exist when the schedule is proposed, which is before the inline newaccount of the plan runs
+   genesis( { genesis_account( alice, false, -1, -1, -1 ),
+              genesis_account( bob,   false, -1, -1, -1 ) } );
+   produce_block();
+
+   auto producer = [&]( name account ) {
+      block_signing_authority_v0 signing_authority;
+      signing_authority.threshold = 1;
+      signing_authority.keys.push_back( {.key = get_public_key( account, "active" ), .weight = 1} );
+      return producer_authority{ .producer_name = account, .authority = signing_authority }.get_abi_variant();
+   };
+
+   BOOST_REQUIRE_EQUAL( 0u, control->active_producers().version );
+   genesis( {}, { producer( alice ), producer( bob ) } );
+
+   while( control->active_producers().version == 0 ) {
+      produce_block();
+   }
+   const auto producers = control->active_producers().producers;
+   BOOST_REQUIRE_EQUAL( 2u,    producers.size() );
+   BOOST_REQUIRE_EQUAL( alice, producers[0].producer_name );
+   BOOST_REQUIRE_EQUAL( bob,   producers[1].producer_name );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
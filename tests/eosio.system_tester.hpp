@@ -533,6 +533,26 @@ public:
       );
    }
 
+   action_result fundloans( const account_name& from, const fc::variants& cpu_loans, const fc::variants& net_loans ) {
+      return push_action( name(from), "fundloans"_n, mvo()
+                          ("from",      from)
+                          ("cpu_loans", cpu_loans)
+                          ("net_loans", net_loans)
+      );
+   }
+
+   action_result defundloans( const account_name& from, const fc::variants& cpu_loans, const fc::variants& net_loans ) {
+      return push_action( name(from), "defundloans"_n, mvo()
+                          ("from",      from)
+                          ("cpu_loans", cpu_loans)
+                          ("net_loans", net_loans)
+      );
+   }
+
+   action_result autofundloan( const account_name& owner, bool enabled ) {
+      return push_action( name(owner), "autofundloan"_n, mvo()("owner", owner)("enabled", enabled) );
+   }
+
    action_result updaterex( const account_name& owner ) {
       return push_action( name(owner), "updaterex"_n, mvo()("owner", owner) );
    }
@@ -557,11 +577,23 @@ public:
       return push_action( name(owner), "closerex"_n, mvo()("owner", owner) );
    }
 
+   // loan rows store core token units; present them as assets like the legacy rex_loan rows
+   fc::variant loan_to_variant( const vector<char>& data ) const {
+      if ( data.empty() ) {
+         return fc::variant();
+      }
+      mvo loan( abi_ser.binary_to_variant( "rex_loan2", data, abi_serializer::create_yield_function(abi_serializer_max_time) ).get_object() );
+      for ( const auto& field : { "payment", "balance", "total_staked" } ) {
+         loan[field] = asset( loan[field].as_int64(), symbol{CORE_SYM} );
+      }
+      return loan;
+   }
+
    fc::variant get_last_loan(bool cpu) {
       vector<char> data;
       const auto& db = control->db();
       namespace chain = eosio::chain;
-      auto table = cpu ? "cpuloan"_n : "netloan"_n;
+      auto table = cpu ? "cpuloan2"_n : "netloan2"_n;
       const auto* t_id = db.find<eosio::chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( config::system_account_name, config::system_account_name, table ) );
       if ( !t_id ) {
          return fc::variant();
@@ -580,7 +612,7 @@ public:
 
       data.resize( itr->value.size() );
       memcpy( data.data(), itr->value.data(), data.size() );
-      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_loan", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      return loan_to_variant( data );
    }
 
    fc::variant get_last_cpu_loan() {
@@ -592,9 +624,9 @@ public:
    }
 
    fc::variant get_loan_info( const uint64_t& loan_num, bool cpu ) const {
-      name table_name = cpu ? "cpuloan"_n : "netloan"_n;
+      name table_name = cpu ? "cpuloan2"_n : "netloan2"_n;
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, table_name, account_name(loan_num) );
-      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_loan", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      return loan_to_variant( data );
    }
 
    fc::variant get_cpu_loan( const uint64_t loan_num ) const {
@@ -687,6 +719,16 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_return_pool", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
    }
 
+   fc::variant get_rex_price_oracle() const {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "rexoracle"_n, account_name(0) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_price_oracle", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_rex_price( uint32_t window ) {
+      auto trace = base_tester::push_action( config::system_account_name, "getrexprice"_n, config::system_account_name, mvo()("window", window) );
+      return abi_ser.binary_to_variant( "rex_price_info", trace->action_traces[0].return_value, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
    fc::variant get_rex_return_buckets() const {
       vector<char> data;
       const auto& db = control->db();
@@ -907,9 +949,29 @@ public:
       issue_and_transfer( name(to), amount );
    }
 
+   // mirrors the Q32 fixed-point stake2vote of the contract, 52 week periods (i.e. ~years) double the weight
    double stake2votes( asset stake ) {
+      static constexpr uint64_t pow2_week_fraction[52] = { // 2^(k/52) in Q62 fixed point
+         0x4000000000000000ull, 0x40dbdb538c8f4b94ull, 0x41baa9eb0c88c2dbull, 0x429c75e908b7d0f3ull,
+         0x43814992dacf602dull, 0x44692f5125040285ull, 0x455431b04b40f774ull, 0x46425b60edfd9296ull,
+         0x4733b73866b8997cull, 0x48285031461f423cull, 0x4920316bd3e58fc2ull, 0x4a1b662e9055dc9bull,
+         0x4b19f9e6b79d78f5ull, 0x4c1bf828c6dc54b7ull, 0x4d216cb102fdc33dull, 0x4e2a636401607ae9ull,
+         0x4f36e84f325407e5ull, 0x504707a96d71fec5ull, 0x515acdd37fd95159ull, 0x52724758bc523df6ull,
+         0x538d80ef8d6167a6ull, 0x54ac877a0950bc4cull, 0x55cf68068834e48dull, 0x56f62fd03bf61069ull,
+         0x5820ec3fca630b01ull, 0x594faaebe955979dull, 0x5a827999fcef3242ull, 0x5bb9663eb7f56663ull,
+         0x5cf47efebe55072bull, 0x5e33d22f49d3ada7ull, 0x5f776e56d0f6fac1ull, 0x60bf622db029347dull,
+         0x620bbc9ed522f02dull, 0x635c8cc86ca195a8ull, 0x64b1e1fc9272a252ull, 0x660bcbc203dbadfaull,
+         0x676a59d4d4674f18ull, 0x68cd9c27251f17b1ull, 0x6a35a2e1de3b00a3ull, 0x6ba27e656b4eb57aull,
+         0x6d143f4a79fd5033ull, 0x6e8af662bb3c3186ull, 0x7006b4b9a72dc03eull, 0x71878b95439cf83eull,
+         0x730d8c76ed22d094ull, 0x7498c91c22fe9eccull, 0x7629537f55aabd50ull, 0x77bf3dd8b836da5eull,
+         0x795a9a9f1471757dull, 0x7afb7c88a1ea31faull, 0x7ca1f68bdfd6c62dull, 0x7e4e1be071e470d7ull
+      };
       auto now = control->pending_block_time().time_since_epoch().count() / 1000000;
-      return stake.get_amount() * pow(2, int64_t((now - (config::block_timestamp_epoch / 1000)) / (86400 * 7))/ double(52) ); // 52 week periods (i.e. ~years)
+      const int64_t  weeks  = int64_t((now - (config::block_timestamp_epoch / 1000)) / (86400 * 7));
+      const __int128 scaled = __int128(stake.get_amount()) * pow2_week_fraction[weeks % 52];
+      const int64_t  shift  = 62 - 32 - weeks / 52;
+      const __int128 votes  = shift >= 0 ? scaled >> shift : scaled << -shift;
+      return double(votes) / double(uint64_t(1) << 32);
    }
 
    double stake2votes( const string& s ) {
@@ -947,6 +1009,11 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state3", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
    }
 
+   fc::variant get_producer_ranking() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "prodranking"_n, "prodranking"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "producer_ranking", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
    fc::variant get_refund_request( name account ) {
       vector<char> data = get_row_by_account( config::system_account_name, account, "refunds"_n, account );
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "refund_request", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
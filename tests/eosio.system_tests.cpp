@@ -5,6 +5,7 @@
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <cstdlib>
 #include <iostream>
+#include <numeric>
 #include <sstream>
 #include <fc/log/logger.hpp>
 #include <eosio/chain/exceptions.hpp>
@@ -173,6 +174,69 @@ BOOST_FIXTURE_TEST_CASE( buysell, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( core_symbol, eosio_system_tester ) try {
+   auto data = get_row_by_account( config::system_account_name, config::system_account_name, "coresymbol"_n, "coresymbol"_n );
+   BOOST_REQUIRE( !data.empty() );
+   auto core = abi_ser.binary_to_variant( "core_symbol_state", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   BOOST_REQUIRE_EQUAL( symbol{CORE_SYM}, core["core"].as<symbol>() );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "alice1111111"_n, "initcoresym"_n, mvo() ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("core symbol has already been recorded"),
+                        push_action( config::system_account_name, "initcoresym"_n, mvo() ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( newaccounts, eosio_system_tester ) try {
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"), config::system_account_name );
+
+   auto newaccounts = [&]( const vector<account_name>& names, uint32_t ram_bytes, bool transfer ) {
+      vector<fc::variant> accounts;
+      for( const auto& a : names ) {
+         accounts.emplace_back( mvo()
+                                ("account", a)
+                                ("owner",   authority( get_public_key( a, "owner" ) ))
+                                ("active",  authority( get_public_key( a, "active" ) )) );
+      }
+      return push_action( "alice1111111"_n, "newaccounts"_n, mvo()
+                          ("creator",            "alice1111111")
+                          ("accounts",           accounts)
+                          ("ram_bytes",          ram_bytes)
+                          ("stake_net_quantity", core_sym::from_string("10.0000"))
+                          ("stake_cpu_quantity", core_sym::from_string("5.0000"))
+                          ("transfer",           transfer) );
+   };
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("must create at least one account"), newaccounts( {}, 8000, false ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("duplicate account name"),
+                        newaccounts( { "dave11111111"_n, "dave11111111"_n }, 8000, false ) );
+
+   const asset init_stake  = get_balance( "eosio.stake" );
+   BOOST_REQUIRE_EQUAL( success(), newaccounts( { "dave11111111"_n, "erin11111111"_n }, 8000, false ) );
+   BOOST_REQUIRE_EQUAL( init_stake + core_sym::from_string("30.0000"), get_balance( "eosio.stake" ) );
+   BOOST_REQUIRE_EQUAL( 300000, get_voter_info( "alice1111111" )["staked"].as_int64() );
+
+   for( const auto& a : { "dave11111111"_n, "erin11111111"_n } ) {
+      auto total = get_total_stake( a );
+      BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), total["net_weight"].as<asset>() );
+      BOOST_REQUIRE_EQUAL( core_sym::from_string("5.0000"), total["cpu_weight"].as<asset>() );
+      BOOST_REQUIRE( total["ram_bytes"].as_int64() >= 7990 );
+      BOOST_REQUIRE_EQUAL( 100000, get_net_limit( a ) );
+      BOOST_REQUIRE_EQUAL( 50000, get_cpu_limit( a ) );
+      auto dbw = get_dbw_obj( "alice1111111"_n, a );
+      BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), dbw["net_weight"].as<asset>() );
+      BOOST_REQUIRE_EQUAL( core_sym::from_string("5.0000"), dbw["cpu_weight"].as<asset>() );
+   }
+
+   // stake transferred to the new account
+   BOOST_REQUIRE_EQUAL( success(), newaccounts( { "frank1111111"_n }, 4000, true ) );
+   BOOST_REQUIRE_EQUAL( true, get_dbw_obj( "alice1111111"_n, "frank1111111"_n ).is_null() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), get_dbw_obj( "frank1111111"_n, "frank1111111"_n )["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 150000, get_voter_info( "frank1111111" )["staked"].as_int64() );
+
+   // accounts that already exist cannot be created again
+   BOOST_REQUIRE( success() != newaccounts( { "frank1111111"_n }, 4000, false ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    cross_15_percent_threshold();
 
@@ -1422,9 +1486,9 @@ BOOST_FIXTURE_TEST_CASE( proxy_actions_affect_producers, eosio_system_tester, *
    //stake increase by proxy itself affects producers
    issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
    BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("30.0001"), core_sym::from_string("20.0001") ) );
-   BOOST_REQUIRE_EQUAL( stake2votes(core_sym::from_string("200.0005")), get_producer_info( "defproducer1" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("200.0005")) == get_producer_info( "defproducer1" )["total_votes"].as_double() );
    BOOST_REQUIRE_EQUAL( 0, get_producer_info( "defproducer2" )["total_votes"].as_double() );
-   BOOST_REQUIRE_EQUAL( stake2votes(core_sym::from_string("200.0005")), get_producer_info( "defproducer3" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("200.0005")) == get_producer_info( "defproducer3" )["total_votes"].as_double() );
 
    //stake decrease by proxy itself affects producers
    BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", core_sym::from_string("10.0001"), core_sym::from_string("10.0001") ) );
@@ -3017,6 +3081,159 @@ BOOST_FIXTURE_TEST_CASE( voters_actions_affect_proxy_and_producers, eosio_system
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( fixed_point_vote_weights, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   auto to_int128 = []( const fc::variant& v ) {
+      __int128 result = 0;
+      for( char c : v.as_string() ) result = result * 10 + (c - '0');
+      return result;
+   };
+
+   create_accounts_with_resources( { "defproducer1"_n, "defproducer2"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer1"_n, 1) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer2"_n, 2) );
+
+   //alice1111111 becomes a proxy for bob111111111 and votes for both producers
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "regproxy"_n, mvo()
+                                                ("proxy",  "alice1111111")
+                                                ("isproxy", true)
+                        )
+   );
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "carol1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("30.0001"), core_sym::from_string("20.0001") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("100.0002"), core_sym::from_string("50.0001") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, vector<account_name>(), "alice1111111"_n ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "carol1111111", core_sym::from_string("11.1111"), core_sym::from_string("22.2222") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "carol1111111"_n, { "defproducer2"_n } ) );
+
+   //stake changes propagate through the proxy without rounding
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", core_sym::from_string("0.0001"), core_sym::from_string("0.0001") ) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "carol1111111", core_sym::from_string("1.1111"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("0.0003"), core_sym::from_string("0.0000") ) );
+
+   const auto alice = get_voter_info( "alice1111111" );
+   const auto bob   = get_voter_info( "bob111111111" );
+   const auto carol = get_voter_info( "carol1111111" );
+   BOOST_REQUIRE_EQUAL( alice["proxied_vote_weight"].as_double(), bob["last_vote_weight"].as_double() );
+   BOOST_REQUIRE( to_int128( alice["fixed_proxied_vote_weight"] ) == to_int128( bob["fixed_last_vote_weight"] ) );
+
+   const auto prod1 = get_producer_info2( "defproducer1" );
+   const auto prod2 = get_producer_info2( "defproducer2" );
+   const auto prod0 = get_producer_info2( "producer1111" );
+   BOOST_REQUIRE( to_int128( prod1["fixed_total_votes"] ) == to_int128( alice["fixed_last_vote_weight"] ) );
+   BOOST_REQUIRE( to_int128( prod2["fixed_total_votes"] ) == to_int128( alice["fixed_last_vote_weight"] )
+                                                             + to_int128( carol["fixed_last_vote_weight"] ) );
+
+   //the global tally is exactly the sum of the producer tallies
+   BOOST_REQUIRE( to_int128( get_global_state()["fixed_total_producer_vote_weight"] )
+                  == to_int128( prod0["fixed_total_votes"] ) + to_int128( prod1["fixed_total_votes"] ) + to_int128( prod2["fixed_total_votes"] ) );
+
+   //floating-point fields remain as views of the fixed-point values
+   BOOST_REQUIRE_EQUAL( double( to_int128( prod2["fixed_total_votes"] ) ) / double( uint64_t(1) << 32 ),
+                        get_producer_info( "defproducer2" )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( proxied_stake_change_propagation, eosio_system_tester, * boost::unit_test::tolerance(1e+6) ) try {
+   cross_15_percent_threshold();
+
+   auto to_int128 = []( const fc::variant& v ) {
+      __int128 result = 0;
+      for( char c : v.as_string() ) result = result * 10 + (c - '0');
+      return result;
+   };
+
+   create_accounts_with_resources( { "donald111111"_n, "defproducer1"_n, "defproducer2"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer1"_n, 1) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer2"_n, 2) );
+
+   //alice1111111 is a proxy voting for both producers, bob111111111 and carol1111111 vote through her
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "regproxy"_n, mvo()
+                                                ("proxy",  "alice1111111")
+                                                ("isproxy", true)
+                        )
+   );
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "carol1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("30.0000"), core_sym::from_string("20.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, vector<account_name>(), "alice1111111"_n ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "carol1111111", core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "carol1111111"_n, vector<account_name>(), "alice1111111"_n ) );
+
+   //a proxy cannot vote through another proxy, so propagation never goes more than one level up
+   BOOST_REQUIRE_EQUAL( success(), push_action( "donald111111"_n, "regproxy"_n, mvo()
+                                                ("proxy",  "donald111111")
+                                                ("isproxy", true)
+                        )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account registered as a proxy is not allowed to use a proxy" ),
+                        vote( "alice1111111"_n, vector<account_name>(), "donald111111"_n ) );
+
+   //stake changes of the proxied voters and of the proxy itself reach the producers through the proxy
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("25.0000"), core_sym::from_string("25.0000") ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("220.0000")) == get_voter_info( "alice1111111" )["proxied_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("270.0000")) == get_producer_info( "defproducer1" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("270.0000")) == get_producer_info( "defproducer2" )["total_votes"].as_double() );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( "carol1111111", core_sym::from_string("5.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("205.0000")) == get_voter_info( "alice1111111" )["proxied_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("255.0000")) == get_producer_info( "defproducer1" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("255.0000")) == get_producer_info( "defproducer2" )["total_votes"].as_double() );
+
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("50.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("205.0000")) == get_voter_info( "alice1111111" )["proxied_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("305.0000")) == get_producer_info( "defproducer1" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("305.0000")) == get_producer_info( "defproducer2" )["total_votes"].as_double() );
+
+   //the proxied weight is exactly what the proxied voters last propagated, and the producers hold the proxy's weight
+   const auto alice = get_voter_info( "alice1111111" );
+   BOOST_REQUIRE( to_int128( alice["fixed_proxied_vote_weight"] ) == to_int128( get_voter_info( "bob111111111" )["fixed_last_vote_weight"] )
+                                                                    + to_int128( get_voter_info( "carol1111111" )["fixed_last_vote_weight"] ) );
+   BOOST_REQUIRE( to_int128( get_producer_info2( "defproducer1" )["fixed_total_votes"] ) == to_int128( alice["fixed_last_vote_weight"] ) );
+   BOOST_REQUIRE( to_int128( get_producer_info2( "defproducer2" )["fixed_total_votes"] ) == to_int128( alice["fixed_last_vote_weight"] ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( refresh_unchanged_vote, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
+   create_accounts_with_resources( { "defproducer1"_n, "defproducer2"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer1"_n, 1) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer2"_n, 2) );
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("30.0001"), core_sym::from_string("20.0001") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+
+   //stake more and refresh the vote with the same producers
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("0.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("60.0002")) == get_producer_info( "defproducer1" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("60.0002")) == get_producer_info( "defproducer2" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("60.0002")) == get_voter_info( "alice1111111" )["last_vote_weight"].as_double() );
+
+   //refreshing still requires every producer to be registered
+   BOOST_REQUIRE_EQUAL( success(), push_action( "defproducer2"_n, "unregprod"_n, mvo()("producer", "defproducer2") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "producer defproducer2 is not currently registered" ),
+                        vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+
+   //refresh through a proxy
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "regproxy"_n, mvo()("proxy", "bob111111111")("isproxy", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, { "defproducer1"_n } ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, vector<account_name>(), "bob111111111"_n ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("0.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, vector<account_name>(), "bob111111111"_n ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("70.0002")) == get_voter_info( "bob111111111" )["proxied_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("70.0002")) == get_producer_info( "defproducer1" )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_FIXTURE_TEST_CASE( vote_both_proxy_and_producers, eosio_system_tester ) try {
    //alice1111111 becomes a proxy
@@ -3227,6 +3444,110 @@ BOOST_FIXTURE_TEST_CASE( elect_producers /*_and_parameters*/, eosio_system_teste
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( producer_ranking, eosio_system_tester ) try {
+   create_accounts_with_resources( {  "defproducer1"_n, "defproducer2"_n, "defproducer3"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer1"_n, 1) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer2"_n, 2) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer3"_n, 3) );
+   BOOST_REQUIRE( get_producer_ranking().is_null() );
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("600000000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("300000000.0000"), core_sym::from_string("300000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer3"_n } ) );
+   issue_and_transfer( "bob111111111", core_sym::from_string("80000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("40000.0000"), core_sym::from_string("40000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, { "defproducer3"_n } ) );
+   produce_blocks(250);
+
+   auto ranking = get_producer_ranking();
+   BOOST_REQUIRE_EQUAL( 1, ranking["epoch"].as_uint64() );
+   auto ranked = ranking["producers"].get_array();
+   BOOST_REQUIRE_EQUAL( 2, ranked.size() );
+   BOOST_REQUIRE_EQUAL( 1, ranked[0]["rank"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( "defproducer3", ranked[0]["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( get_producer_info( "defproducer3" )["total_votes"].as_double(), ranked[0]["total_votes"].as_double() );
+   BOOST_REQUIRE_EQUAL( 0, ranked[0]["location"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 2, ranked[1]["rank"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( "defproducer1", ranked[1]["owner"].as_string() );
+
+   // the snapshot is only written when a new schedule is proposed
+   const auto last_update = ranking["last_update"].as_string();
+   produce_blocks(250);
+   ranking = get_producer_ranking();
+   BOOST_REQUIRE_EQUAL( 1, ranking["epoch"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( last_update, ranking["last_update"].as_string() );
+
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, { "defproducer2"_n, "defproducer3"_n } ) );
+   produce_blocks(250);
+   ranking = get_producer_ranking();
+   BOOST_REQUIRE_EQUAL( 2, ranking["epoch"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 3, ranking["producers"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( "defproducer2", ranking["producers"].get_array()[2]["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( 3, control->head_block_state()->active_schedule.producers.size() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( schedule_ordered_by_latency, eosio_system_tester ) try {
+   const std::vector<account_name> producers = { "defproducer1"_n, "defproducer2"_n, "defproducer3"_n, "defproducer4"_n };
+   create_accounts_with_resources( producers );
+   for( uint16_t i = 0; i < producers.size(); ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( producers[i], "regproducer"_n, mvo()
+                                                   ("producer",  producers[i])
+                                                   ("producer_key", get_public_key( producers[i], "active") )
+                                                   ("url", "")
+                                                   ("location", i + 1 )
+                           )
+      );
+   }
+
+   auto setlatency = [&]( const account_name& signer, const std::vector<uint16_t>& locations, const std::vector<uint32_t>& latencies ) {
+      return push_action( signer, "setlatency"_n, mvo()("locations", locations)("latencies", latencies) );
+   };
+   // locations 1-3, 3-2, 2-4 and 4-1 are close to each other
+   const std::vector<uint16_t> locations = { 1, 2, 3, 4 };
+   const std::vector<uint32_t> latencies = {   0, 100,  10,  10,
+                                             100,   0,  10,  10,
+                                              10,  10,   0, 100,
+                                              10,  10, 100,   0 };
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"), setlatency( "alice1111111"_n, locations, latencies ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("locations must be unique and sorted"),
+                        setlatency( config::system_account_name, { 1, 3, 2, 4 }, latencies ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("latencies must hold one entry per pair of locations"),
+                        setlatency( config::system_account_name, locations, { 0, 10 } ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("latencies must be empty when no locations are given"),
+                        setlatency( config::system_account_name, {}, { 0 } ) );
+   {
+      // the number of locations is bounded, so the size of the matrix cannot wrap around
+      std::vector<uint16_t> too_many( 257 );
+      std::iota( too_many.begin(), too_many.end(), 0 );
+      BOOST_REQUIRE_EQUAL( wasm_assert_msg("too many locations"), setlatency( config::system_account_name, too_many, {} ) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), setlatency( config::system_account_name, locations, latencies ) );
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("600000000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("300000000.0000"), core_sym::from_string("300000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, producers ) );
+   produce_blocks(250);
+
+   auto producer_keys = control->head_block_state()->active_schedule.producers;
+   BOOST_REQUIRE_EQUAL( 4, producer_keys.size() );
+   BOOST_REQUIRE_EQUAL( name("defproducer1"), producer_keys[0].producer_name );
+   BOOST_REQUIRE_EQUAL( name("defproducer3"), producer_keys[1].producer_name );
+   BOOST_REQUIRE_EQUAL( name("defproducer2"), producer_keys[2].producer_name );
+   BOOST_REQUIRE_EQUAL( name("defproducer4"), producer_keys[3].producer_name );
+
+   // removing the latencies restores ordering by name
+   BOOST_REQUIRE_EQUAL( success(), setlatency( config::system_account_name, {}, {} ) );
+   produce_blocks(250);
+   producer_keys = control->head_block_state()->active_schedule.producers;
+   BOOST_REQUIRE_EQUAL( 4, producer_keys.size() );
+   for( size_t i = 0; i < producers.size(); ++i ) {
+      BOOST_REQUIRE_EQUAL( producers[i], producer_keys[i].producer_name );
+   }
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_FIXTURE_TEST_CASE( buyname, eosio_system_tester ) try {
    create_accounts_with_resources( { "dan"_n, "sam"_n } );
@@ -4699,6 +5020,212 @@ BOOST_FIXTURE_TEST_CASE( rex_loan_checks, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_price_oracle, eosio_system_tester ) try {
+
+   const asset   init_balance = core_sym::from_string("40000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("25000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, core_sym::from_string("300.0000") ) );
+   BOOST_REQUIRE_EQUAL( false,     get_rex_price_oracle().is_null() );
+
+   auto pool = get_rex_pool();
+   const double init_price = double(pool["total_lendable"].as<asset>().get_amount()) / pool["total_rex"].as<asset>().get_amount();
+   auto price = get_rex_price( 3600 );
+   BOOST_REQUIRE_EQUAL( init_price, price["rex_price"].as_double() );
+   BOOST_REQUIRE_EQUAL( init_price, price["twap_rex_price"].as_double() );
+   BOOST_REQUIRE_EQUAL( 0,          price["twap_window"].as<uint32_t>() );
+
+   // rental fees flow into the pool once their return bucket closes, raising the REX price
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 1 ) );
+   for ( int i = 0; i < 6; ++i ) {
+      produce_block( fc::hours(1) );
+      BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 1 ) );
+   }
+
+   price = get_rex_price( 3 * 3600 );
+   BOOST_REQUIRE( init_price < price["rex_price"].as_double() );
+   BOOST_REQUIRE( init_price <= price["twap_rex_price"].as_double() );
+   BOOST_REQUIRE( price["twap_rex_price"].as_double() <= price["rex_price"].as_double() );
+   BOOST_REQUIRE( 3 * 3600 <= price["twap_window"].as<uint32_t>() );
+   BOOST_REQUIRE( 6 * 3600 > price["twap_window"].as<uint32_t>() );
+
+   // the window is capped by the recorded history
+   price = get_rex_price( 30 * 24 * 3600 );
+   BOOST_REQUIRE( 31 * 3600 >= price["twap_window"].as<uint32_t>() );
+   BOOST_REQUIRE( init_price <= price["twap_rex_price"].as_double() );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( alice, "setrexoracle"_n, mvo()("sample_interval", 600)("num_samples", 12) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("sample interval must be positive"),
+                        push_action( config::system_account_name, "setrexoracle"_n, mvo()("sample_interval", 0)("num_samples", 12) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("number of samples is too large"),
+                        push_action( config::system_account_name, "setrexoracle"_n, mvo()("sample_interval", 600)("num_samples", 30 * 24 + 1) ) );
+
+   // the largest buffer is filled and then cleared by a single setrexoracle
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( config::system_account_name, "setrexoracle"_n, mvo()("sample_interval", 1)("num_samples", 30 * 24) ) );
+   for ( int i = 1; i < 30 * 24; ++i ) {
+      produce_block( fc::seconds(1) );
+      BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 1 ) );
+   }
+   BOOST_REQUIRE_EQUAL( 30 * 24 - 1, get_rex_price_oracle()["head"].as<uint16_t>() );
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( config::system_account_name, "setrexoracle"_n, mvo()("sample_interval", 600)("num_samples", 12) ) );
+   BOOST_REQUIRE_EQUAL( 600, get_rex_price_oracle()["sample_interval"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( 12,  get_rex_price_oracle()["num_samples"].as<uint16_t>() );
+   BOOST_REQUIRE_EQUAL( 0,   get_rex_price_oracle()["head"].as<uint16_t>() );
+
+} FC_LOG_AND_RETHROW()
+
+
+BOOST_FIXTURE_TEST_CASE( rex_legacy_loan_migration, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("25000.0000");
+   const asset payment      = core_sym::from_string("10.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n, "carolaccount"_n, "emilyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1], carol = accounts[2], emily = accounts[3];
+   setup_rex_accounts( accounts, init_balance );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( emily, core_sym::from_string("20000.0000") ) );
+
+   auto has_legacy_loan = [&]( uint64_t loan_num, bool cpu ) {
+      return !get_row_by_account( config::system_account_name, config::system_account_name,
+                                  cpu ? "cpuloan"_n : "netloan"_n, account_name(loan_num) ).empty();
+   };
+   // loan numbers found for `receiver` through the byreceiver index of a compact loan table
+   auto loans_by_receiver = [&]( const account_name& receiver, bool cpu ) {
+      namespace chain = eosio::chain;
+      const auto& db       = control->db();
+      const auto  table    = cpu ? "cpuloan2"_n : "netloan2"_n;
+      const auto  idx_name = name( (table.to_uint64_t() & 0xFFFFFFFFFFFFFFF0ULL) | 2 ); // third secondary index
+      std::vector<uint64_t> loans;
+      const auto* t_id = db.find<chain::table_id_object, chain::by_code_scope_table>(
+                            boost::make_tuple( config::system_account_name, config::system_account_name, idx_name ) );
+      if ( !t_id ) {
+         return loans;
+      }
+      const auto& idx = db.get_index<chain::index64_index, chain::by_secondary>();
+      for ( auto itr = idx.lower_bound( boost::make_tuple( t_id->id, receiver.to_uint64_t() ) );
+            itr != idx.end() && itr->t_id == t_id->id && itr->secondary_key == receiver.to_uint64_t(); ++itr ) {
+         loans.push_back( itr->primary_key );
+      }
+      return loans;
+   };
+
+   // loans rented under the previous contract version are left in the legacy tables
+   set_code( config::system_account_name, contracts::util::system_wasm_v1_8() );
+   set_abi(  config::system_account_name, contracts::util::system_abi_v1_8().data() );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( alice, alice, payment ) );                                // loan 1
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( carol, bob,   payment ) );                                // loan 2
+   BOOST_REQUIRE_EQUAL( success(), rentnet( alice, alice, payment, core_sym::from_string("2.0000") ) ); // loan 3
+   BOOST_REQUIRE_EQUAL( success(), rentnet( carol, bob,   payment ) );                                // loan 4
+   set_code( config::system_account_name, contracts::system_wasm() );
+   set_abi(  config::system_account_name, contracts::system_abi().data() );
+   produce_block();
+
+   BOOST_REQUIRE( has_legacy_loan( 1, true ) && has_legacy_loan( 2, true ) );
+   BOOST_REQUIRE( has_legacy_loan( 3, false ) && has_legacy_loan( 4, false ) );
+   BOOST_REQUIRE( get_cpu_loan( 1 ).is_null() && get_net_loan( 3 ).is_null() );
+
+   // funding and defunding move the loan they touch
+   BOOST_REQUIRE_EQUAL( success(), fundcpuloan( alice, 1, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE( !has_legacy_loan( 1, true ) );
+   BOOST_REQUIRE_EQUAL( alice,                             get_cpu_loan( 1 )["from"].as<account_name>() );
+   BOOST_REQUIRE_EQUAL( payment,                           get_cpu_loan( 1 )["payment"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"),   get_cpu_loan( 1 )["balance"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( success(), defundnetloan( alice, 3, core_sym::from_string("0.5000") ) );
+   BOOST_REQUIRE( !has_legacy_loan( 3, false ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.5000"),   get_net_loan( 3 )["balance"].as<asset>() );
+
+   // other REX actions leave unexpired legacy loans where they are
+   BOOST_REQUIRE_EQUAL( success(), buyrex( bob, core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE( has_legacy_loan( 2, true ) && has_legacy_loan( 4, false ) );
+
+   // closerex sees the loans left in the legacy tables
+   BOOST_REQUIRE_EQUAL( success(), withdraw( carol, get_rex_fund( carol ) ) );
+   BOOST_REQUIRE_EQUAL( success(), closerex( carol ) );
+   BOOST_REQUIRE( !get_rex_fund_obj( carol ).is_null() );
+
+   // rexexec moves the remaining ones, which can then be found by receiver
+   BOOST_REQUIRE( loans_by_receiver( bob, true ).empty() );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( emily, 4 ) );
+   BOOST_REQUIRE( !has_legacy_loan( 2, true ) && !has_legacy_loan( 4, false ) );
+   BOOST_REQUIRE_EQUAL( carol, get_cpu_loan( 2 )["from"].as<account_name>() );
+   BOOST_REQUIRE_EQUAL( carol, get_net_loan( 4 )["from"].as<account_name>() );
+   BOOST_REQUIRE( loans_by_receiver( bob, true )    == std::vector<uint64_t>{ 2 } );
+   BOOST_REQUIRE( loans_by_receiver( bob, false )   == std::vector<uint64_t>{ 4 } );
+   BOOST_REQUIRE( loans_by_receiver( alice, false ) == std::vector<uint64_t>{ 3 } );
+
+   // and closerex keeps seeing them in the compact tables
+   BOOST_REQUIRE_EQUAL( success(), closerex( carol ) );
+   BOOST_REQUIRE( !get_rex_fund_obj( carol ).is_null() );
+
+   // expired loans are processed as before
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( emily, 4 ) );
+   BOOST_REQUIRE( get_cpu_loan( 2 ).is_null() && get_net_loan( 4 ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), closerex( carol ) );
+   BOOST_REQUIRE( get_rex_fund_obj( carol ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( rex_loan_bulk_funding, eosio_system_tester ) try {
+
+   const asset   init_balance = core_sym::from_string("40000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+
+   const asset payment = core_sym::from_string("30.0000");
+   const asset fund    = core_sym::from_string("20.0000");
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("25000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, payment ) ); // loan_num = 1
+   BOOST_REQUIRE_EQUAL( success(), rentnet( bob, bob, payment ) ); // loan_num = 2
+
+   auto loan = []( uint64_t loan_num, const asset& amount ) -> fc::variant {
+      return mvo()("loan_num", loan_num)("amount", amount);
+   };
+
+   const asset bob_fund = get_rex_fund( bob );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no loans specified"),        fundloans( bob, {}, {} ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("loan not found"),            fundloans( bob, { loan( 2, fund ) }, {} ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("user must be loan creator"), fundloans( alice, { loan( 1, fund ) }, {} ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient funds"),        fundloans( bob, { loan( 1, bob_fund ) }, { loan( 2, fund ) } ) );
+   BOOST_REQUIRE_EQUAL( success(),                                    fundloans( bob, { loan( 1, fund + fund ) }, { loan( 2, fund ) } ) );
+   BOOST_REQUIRE_EQUAL( bob_fund - fund - fund - fund, get_rex_fund( bob ) );
+   BOOST_REQUIRE_EQUAL( fund + fund,                   get_cpu_loan(1)["balance"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( fund,                          get_net_loan(2)["balance"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficent loan balance"), defundloans( bob, {}, { loan( 2, fund + fund ) } ) );
+   BOOST_REQUIRE_EQUAL( success(),                                   defundloans( bob, { loan( 1, fund + fund ) }, { loan( 2, fund ) } ) );
+   BOOST_REQUIRE_EQUAL( bob_fund, get_rex_fund( bob ) );
+   BOOST_REQUIRE_EQUAL( 0,        get_cpu_loan(1)["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( 0,        get_net_loan(2)["balance"].as<asset>().get_amount() );
+
+   // with automatic funding, expiring loans with empty funds are renewed out of REX fund
+   BOOST_REQUIRE_EQUAL( success(), autofundloan( bob, true ) );
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(),                     rexexec( alice, 2 ) );
+   BOOST_REQUIRE_EQUAL( false,                         get_cpu_loan(1).is_null() );
+   BOOST_REQUIRE_EQUAL( false,                         get_net_loan(2).is_null() );
+   BOOST_REQUIRE_EQUAL( 0,                             get_cpu_loan(1)["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( bob_fund - payment - payment, get_rex_fund( bob ) );
+
+   // without it, they are closed
+   BOOST_REQUIRE_EQUAL( success(), autofundloan( bob, false ) );
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(),                     rexexec( alice, 2 ) );
+   BOOST_REQUIRE_EQUAL( true,                          get_cpu_loan(1).is_null() );
+   BOOST_REQUIRE_EQUAL( true,                          get_net_loan(2).is_null() );
+   BOOST_REQUIRE_EQUAL( bob_fund - payment - payment, get_rex_fund( bob ) );
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( ramfee_namebid_to_rex, eosio_system_tester ) try {
 
    const int64_t ratio        = 10000;
@@ -4942,14 +5469,15 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
 
       BOOST_REQUIRE_EQUAL( success(),                   mvtosavings( alice, asset( 8 * rex_bucket.get_amount(), rex_sym ) ) );
       rex_balance = get_rex_balance_obj( alice );
-      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 0,                           rex_balance["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( 0,                           rex_balance["matured_rex"].as<int64_t>() );
+      BOOST_REQUIRE_EQUAL( 8 * rex_bucket.get_amount(), rex_balance["rex_savings"].as<int64_t>() );
       produce_block( fc::days(1000) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
                            sellrex( alice, asset::from_string( "1.0000 REX" ) ) );
       BOOST_REQUIRE_EQUAL( success(),                   mvfrsavings( alice, asset::from_string( "10.0000 REX" ) ) );
       rex_balance = get_rex_balance_obj( alice );
-      BOOST_REQUIRE_EQUAL( 2,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
       produce_block( fc::days(3) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
                            sellrex( alice, asset::from_string( "1.0000 REX" ) ) );
@@ -4959,7 +5487,7 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
                            sellrex( alice, asset::from_string( "10.0001 REX" ) ) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( alice, asset::from_string( "10.0000 REX" ) ) );
       rex_balance = get_rex_balance_obj( alice );
-      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 0,                           rex_balance["rex_maturities"].get_array().size() );
       produce_block( fc::days(100) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
                            sellrex( alice, asset::from_string( "0.0001 REX" ) ) );
@@ -4982,28 +5510,29 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
       BOOST_REQUIRE_EQUAL( 0,                           rex_balance["matured_rex"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( success(),                   mvtosavings( bob, asset( rex_bucket.get_amount() / 2, rex_sym ) ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 6,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 5,                           rex_balance["rex_maturities"].get_array().size() );
 
       BOOST_REQUIRE_EQUAL( success(),                   mvtosavings( bob, asset( rex_bucket.get_amount() / 2, rex_sym ) ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 5,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 4,                           rex_balance["rex_maturities"].get_array().size() );
       produce_block( fc::days(1) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( bob, rex_bucket ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 4,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 3,                           rex_balance["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( 0,                           rex_balance["matured_rex"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( 4 * rex_bucket.get_amount(), rex_balance["rex_balance"].as<asset>().get_amount() );
 
       BOOST_REQUIRE_EQUAL( success(),                   mvtosavings( bob, asset( 3 * rex_bucket.get_amount() / 2, rex_sym ) ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 3,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 2,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 5 * rex_bucket.get_amount(), 2 * rex_balance["rex_savings"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
                            sellrex( bob, rex_bucket ) );
 
       produce_block( fc::days(1) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( bob, rex_bucket ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 2,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( 0,                           rex_balance["matured_rex"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( 3 * rex_bucket.get_amount(), rex_balance["rex_balance"].as<asset>().get_amount() );
 
@@ -5012,7 +5541,7 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
                            sellrex( bob, rex_bucket ) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( bob, asset( rex_bucket.get_amount() / 2, rex_sym ) ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 0,                           rex_balance["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( 0,                           rex_balance["matured_rex"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( 5 * rex_bucket.get_amount(), 2 * rex_balance["rex_balance"].as<asset>().get_amount() );
 
@@ -5022,12 +5551,12 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient REX in savings"),
                            mvfrsavings( bob, asset( 3 * rex_bucket.get_amount(), rex_sym ) ) );
       BOOST_REQUIRE_EQUAL( success(),                   mvfrsavings( bob, rex_bucket ) );
-      BOOST_REQUIRE_EQUAL( 2,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 1,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient REX balance"),
                            mvtosavings( bob, asset( 3 * rex_bucket.get_amount() / 2, rex_sym ) ) );
       produce_block( fc::days(1) );
       BOOST_REQUIRE_EQUAL( success(),                   mvfrsavings( bob, rex_bucket ) );
-      BOOST_REQUIRE_EQUAL( 3,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 2,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
       produce_block( fc::days(4) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( bob, rex_bucket ) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
@@ -5035,22 +5564,22 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
       produce_block( fc::days(1) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( bob, rex_bucket ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 0,                           rex_balance["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( rex_bucket.get_amount() / 2, rex_balance["rex_balance"].as<asset>().get_amount() );
 
       BOOST_REQUIRE_EQUAL( success(),                   mvfrsavings( bob, asset( rex_bucket.get_amount() / 4, rex_sym ) ) );
       produce_block( fc::days(2) );
       BOOST_REQUIRE_EQUAL( success(),                   mvfrsavings( bob, asset( rex_bucket.get_amount() / 8, rex_sym ) ) );
-      BOOST_REQUIRE_EQUAL( 3,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
-      BOOST_REQUIRE_EQUAL( success(),                   consolidate( bob ) );
       BOOST_REQUIRE_EQUAL( 2,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( success(),                   consolidate( bob ) );
+      BOOST_REQUIRE_EQUAL( 1,                           get_rex_balance_obj( bob )["rex_maturities"].get_array().size() );
 
       produce_block( fc::days(5) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
                            sellrex( bob, asset( rex_bucket.get_amount() / 2, rex_sym ) ) );
       BOOST_REQUIRE_EQUAL( success(),                   sellrex( bob, asset( 3 * rex_bucket.get_amount() / 8, rex_sym ) ) );
       rex_balance = get_rex_balance_obj( bob );
-      BOOST_REQUIRE_EQUAL( 1,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 0,                           rex_balance["rex_maturities"].get_array().size() );
       BOOST_REQUIRE_EQUAL( 0,                           rex_balance["matured_rex"].as<int64_t>() );
       BOOST_REQUIRE_EQUAL( rex_bucket.get_amount() / 8, rex_balance["rex_balance"].as<asset>().get_amount() );
       BOOST_REQUIRE_EQUAL( success(),                   mvfrsavings( bob, get_rex_balance( bob ) ) );
@@ -5105,11 +5634,11 @@ BOOST_FIXTURE_TEST_CASE( rex_savings, eosio_system_tester ) try {
 
       BOOST_REQUIRE_EQUAL( success(),                   mvtosavings( carol, half_rex_bucket ) );
       rex_balance = get_rex_balance_obj( carol );
-      BOOST_REQUIRE_EQUAL( 3,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 2,                           rex_balance["rex_maturities"].get_array().size() );
 
       BOOST_REQUIRE_EQUAL( success(),                   buyrex( carol, half_payment ) );
       rex_balance = get_rex_balance_obj( carol );
-      BOOST_REQUIRE_EQUAL( 3,                           rex_balance["rex_maturities"].get_array().size() );
+      BOOST_REQUIRE_EQUAL( 2,                           rex_balance["rex_maturities"].get_array().size() );
 
       produce_block( fc::days(5) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("asset must be a positive amount of (REX, 4)"),
@@ -5289,6 +5818,52 @@ BOOST_FIXTURE_TEST_CASE( update_rex_vote, eosio_system_tester, * boost::unit_tes
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( rex_vote_stake_drift, eosio_system_tester ) try {
+
+   cross_15_percent_threshold();
+
+   std::vector<account_name> producer_names;
+   {
+      producer_names.reserve('u' - 'a' + 1);
+      const std::string root("defproducer");
+      for ( char c = 'a'; c <= 'u'; ++c ) {
+         producer_names.emplace_back(root + std::string(1, c));
+      }
+
+      setup_producer_accounts(producer_names);
+      for ( const auto& p: producer_names ) {
+         BOOST_REQUIRE_EQUAL( success(), regproducer(p) );
+      }
+   }
+
+   const asset init_balance = core_sym::from_string("30000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n, "emilyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1], emily = accounts[2];
+   setup_rex_accounts( accounts, init_balance );
+
+   const int64_t init_stake_amount = get_voter_info( alice )["staked"].as<int64_t>();
+   const asset purchase = core_sym::from_string("25000.0000");
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, purchase ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( alice, producer_names ) );
+   BOOST_REQUIRE_EQUAL( purchase,  get_rex_vote_stake(alice) );
+
+   // appreciation of 1 / 25000 of the vote stake is below the drift threshold and is not revalued by voting
+   const asset rent = core_sym::from_string("1.0000");
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( emily, bob, rent ) );
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( alice, 1 ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( alice, producer_names ) );
+   BOOST_REQUIRE_EQUAL( purchase,  get_rex_vote_stake(alice) );
+   BOOST_REQUIRE_EQUAL( purchase.get_amount(), get_voter_info(alice)["staked"].as<int64_t>() - init_stake_amount );
+
+   // updaterex always revalues
+   BOOST_REQUIRE_EQUAL( success(), updaterex( alice ) );
+   BOOST_TEST_REQUIRE( within_one( (purchase + rent).get_amount(), get_rex_vote_stake(alice).get_amount() ) );
+   BOOST_REQUIRE_EQUAL( get_rex_vote_stake(alice).get_amount(),
+                        get_voter_info(alice)["staked"].as<int64_t>() - init_stake_amount );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( deposit_rex_fund, eosio_system_tester ) try {
 
    const asset init_balance = core_sym::from_string("1000.0000");
@@ -5426,6 +6001,52 @@ BOOST_FIXTURE_TEST_CASE( close_rex, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( rex_order_erased_and_queued_in_one_action, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("200000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n, "frankaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1], frank = accounts[2];
+   setup_rex_accounts( accounts, init_balance );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("50000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( bob,   core_sym::from_string("100000.0000") ) );
+   produce_block( fc::days(5) );
+
+   // frank's loan leaves too little unlent for the sell orders below to be filled
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( frank, frank, core_sym::from_string("100000.0000") ) );
+
+   const asset alice_sell = asset( get_rex_balance(alice).get_amount() / 2, symbol{SY(4,REX)} );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( alice, alice_sell ) );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( bob,   asset( get_rex_balance(bob).get_amount() / 2, symbol{SY(4,REX)} ) ) );
+   BOOST_REQUIRE_EQUAL( true,      get_rex_order(alice)["is_open"].as<bool>() );
+   BOOST_REQUIRE_EQUAL( true,      get_rex_order(bob)["is_open"].as<bool>() );
+
+   // rent returns raise total_unlent enough to fill alice's order, which is first in the queue, but not bob's
+   produce_block( fc::days(10) );
+
+   const auto init_bob_order  = get_rex_order_obj( bob );
+   const auto init_alice_fund = get_rex_fund( alice );
+
+   // in one sellrex action alice's order is filled by runrex, erased by update_rex_account and a new
+   // order is queued for the rest of her REX, while bob's order row follows hers in the table
+   {
+      auto trace  = base_tester::push_action( config::system_account_name, "sellrex"_n, alice,
+                                              mvo()("from", alice)("rex", alice_sell) );
+      auto output = get_rexorder_result( trace );
+      BOOST_REQUIRE_EQUAL( output.size(),   1 );
+      BOOST_REQUIRE_EQUAL( output[0].first, alice );
+      BOOST_REQUIRE_EQUAL( init_alice_fund + output[0].second, get_rex_fund( alice ) );
+   }
+
+   BOOST_REQUIRE_EQUAL( alice_sell, get_rex_balance( alice ) );
+   BOOST_REQUIRE_EQUAL( true,       get_rex_order(alice)["is_open"].as<bool>() );
+   BOOST_REQUIRE_EQUAL( alice_sell, get_rex_order(alice)["rex_requested"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 0,          get_rex_order(alice)["proceeds"].as<asset>().get_amount() );
+
+   REQUIRE_MATCHING_OBJECT( init_bob_order, get_rex_order_obj( bob ) );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_FIXTURE_TEST_CASE( set_rex, eosio_system_tester ) try {
 
@@ -5693,6 +6314,44 @@ BOOST_FIXTURE_TEST_CASE( rex_return, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( rex_return_fee_accumulation, eosio_system_tester ) try {
+
+   constexpr uint32_t total_intervals = 30 * 144;
+   const asset init_balance = core_sym::from_string("100000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+   transfer( config::system_account_name, bob, core_sym::from_string("100.0000"), config::system_account_name );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("100000.0000") ) );
+   const asset rent    = core_sym::from_string("30.0000");
+   const asset ram_fee = core_sym::from_string("0.1000");
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, rent ) );
+
+   // a fee arriving after the pending bucket is due closes that bucket first
+   produce_block( fc::hours(13) );
+   BOOST_REQUIRE_EQUAL( success(), buyram( bob, bob, core_sym::from_string("20.0000") ) );
+   auto rex_return_pool = get_rex_return_pool();
+   BOOST_REQUIRE_EQUAL( rent.get_amount() / total_intervals, rex_return_pool["current_rate_of_increase"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( 1,                                   get_rex_return_buckets()["return_buckets"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( ram_fee.get_amount(),                rex_return_pool["pending_bucket_proceeds"].as<int64_t>() );
+   const uint32_t t0 = rex_return_pool["last_dist_time"].as<time_point_sec>().sec_since_epoch();
+
+   // later fees only accumulate in the pending bucket; returns are distributed by runrex
+   produce_block( fc::minutes(20) );
+   const asset init_lendable = get_rex_pool()["total_lendable"].as<asset>();
+   BOOST_REQUIRE_EQUAL( success(),                 buyram( bob, bob, core_sym::from_string("20.0000") ) );
+   rex_return_pool = get_rex_return_pool();
+   BOOST_REQUIRE_EQUAL( 2 * ram_fee.get_amount(),  rex_return_pool["pending_bucket_proceeds"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( t0,                        rex_return_pool["last_dist_time"].as<time_point_sec>().sec_since_epoch() );
+   BOOST_REQUIRE_EQUAL( init_lendable,             get_rex_pool()["total_lendable"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( success(),                 rexexec( bob, 1 ) );
+   BOOST_TEST_REQUIRE( t0 < get_rex_return_pool()["last_dist_time"].as<time_point_sec>().sec_since_epoch() );
+   BOOST_TEST_REQUIRE( init_lendable < get_rex_pool()["total_lendable"].as<asset>() );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_AUTO_TEST_CASE( setabi_bios ) try {
    fc::temp_directory tempdir;
@@ -5755,6 +6414,22 @@ BOOST_FIXTURE_TEST_CASE( setabi, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( getabihashes, eosio_system_tester ) try {
+   set_abi( "eosio.token"_n, contracts::token_abi().data() );
+   auto abi = fc::raw::pack(fc::json::from_string( (const char*)contracts::token_abi().data()).template as<abi_def>());
+   auto token_hash = fc::sha256::hash( (const char*)abi.data(), abi.size() );
+
+   auto trace = base_tester::push_action( config::system_account_name, "getabihashes"_n, config::system_account_name,
+                                          mvo()("accounts", vector<name>{ "eosio.token"_n, "alice1111111"_n }) );
+   auto hashes = fc::raw::unpack<vector<_abi_hash>>( trace->action_traces[0].return_value );
+
+   BOOST_REQUIRE_EQUAL( 2, hashes.size() );
+   BOOST_REQUIRE_EQUAL( "eosio.token"_n, hashes[0].owner );
+   BOOST_REQUIRE( token_hash == hashes[0].hash );
+   BOOST_REQUIRE_EQUAL( "alice1111111"_n, hashes[1].owner );
+   BOOST_REQUIRE( fc::sha256() == hashes[1].hash );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( change_limited_account_back_to_unlimited, eosio_system_tester ) try {
    BOOST_REQUIRE( get_total_stake( "eosio" ).is_null() );
 
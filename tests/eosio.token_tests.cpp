@@ -53,6 +53,14 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "currency_stats", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
    }
 
+   fc::variant get_metadata( const string& symbolname )
+   {
+      auto symb = eosio::chain::symbol::from_string(symbolname);
+      auto symbol_code = symb.to_symbol_code().value;
+      vector<char> data = get_row_by_account( "eosio.token"_n, name(symbol_code), "tokenmeta"_n, account_name(symbol_code) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "token_metadata", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
    fc::variant get_account( account_name acc, const string& symbolname)
    {
       auto symb = eosio::chain::symbol::from_string(symbolname);
@@ -98,6 +106,12 @@ public:
       );
    }
 
+   action_result initmeta( account_name actor, const string& sym ) {
+      return push_action( actor, "initmeta"_n, mvo()
+           ( "sym", sym )
+      );
+   }
+
    action_result open( account_name owner,
                        const string& symbolname,
                        account_name ram_payer    ) {
@@ -337,6 +351,172 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
       transfer( "alice"_n, "bob"_n, asset::from_string("-1000 CERO"), "hola" )
    );
 
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfer( "alice"_n, "bob"_n, asset::from_string("1.0 CERO"), "hola" )
+   );
+
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( systransfer_tests, eosio_token_tester ) try {
+
+   create_accounts( { "eosio.stake"_n, "eosio.rex"_n } );
+   create( "eosio"_n, asset::from_string("1000 CERO") );
+   issue( "eosio"_n, asset::from_string("1000 CERO"), "issue" );
+   transfer( "eosio"_n, "eosio.stake"_n, asset::from_string("500 CERO"), "stake" );
+   transfer( "eosio"_n, "alice"_n, asset::from_string("100 CERO"), "hola" );
+
+   auto systransfer = [&]( account_name from, account_name to, const vector<account_name>& signers ) {
+      return base_tester::push_action( "eosio.token"_n, "systransfer"_n, signers, mvo()
+         ( "from", from )
+         ( "to", to )
+         ( "quantity", asset::from_string("200 CERO") )
+         ( "memo", "" )
+      );
+   };
+
+   BOOST_REQUIRE_THROW( systransfer( "eosio.stake"_n, "eosio.rex"_n, { "eosio.stake"_n } ), missing_auth_exception );
+   BOOST_REQUIRE_EXCEPTION( systransfer( "alice"_n, "eosio.rex"_n, { "eosio"_n, "alice"_n } ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("only system accounts can transfer without notification") );
+   BOOST_REQUIRE_EXCEPTION( systransfer( "eosio.stake"_n, "bob"_n, { "eosio"_n, "eosio.stake"_n } ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("only system accounts can transfer without notification") );
+
+   auto trace = systransfer( "eosio.stake"_n, "eosio.rex"_n, { "eosio"_n, "eosio.stake"_n } );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+
+   REQUIRE_MATCHING_OBJECT( get_account("eosio.stake"_n, "0,CERO"), mvo()
+      ("balance", "300 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("eosio.rex"_n, "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( deploy_without_protocol_features ) try {
+   // only PREACTIVATE_FEATURE is active, GET_CODE_HASH and the other host function features are not
+   tester t( setup_policy::preactivate_feature_only );
+   BOOST_REQUIRE( !t.control->is_builtin_activated( builtin_protocol_feature_t::get_code_hash ) );
+
+   t.create_accounts( { "alice"_n, "eosio.token"_n } );
+   t.set_code( "eosio.token"_n, contracts::token_wasm() );
+   t.set_abi( "eosio.token"_n, contracts::token_abi().data() );
+   t.produce_block();
+
+   t.push_action( "eosio.token"_n, "create"_n, "eosio.token"_n, mvo()
+      ( "issuer", "alice" )
+      ( "maximum_supply", "1000 CERO" )
+   );
+   t.push_action( "eosio.token"_n, "issue"_n, "alice"_n, mvo()
+      ( "to", "alice" )
+      ( "quantity", "500 CERO" )
+      ( "memo", "" )
+   );
+   t.produce_block();
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( settle_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO") );
+   issue( "alice"_n, asset::from_string("1000 CERO"), "issue" );
+   create( "bob"_n, asset::from_string("1000.000 TKN") );
+   issue( "bob"_n, asset::from_string("1000.000 TKN"), "issue" );
+   transfer( "alice"_n, "carol"_n, asset::from_string("10 CERO"), "hola" );
+   produce_blocks(1);
+
+   auto leg = []( account_name from, account_name to, const string& quantity ) {
+      return fc::variant( mvo()("from", from)("to", to)("quantity", quantity) );
+   };
+   auto settle = [&]( const vector<account_name>& signers, const fc::variants& legs ) {
+      return base_tester::push_action( "eosio.token"_n, "settle"_n, signers, mvo()
+         ( "payer", "alice" )
+         ( "legs", legs )
+         ( "memo", "" )
+      );
+   };
+
+   BOOST_REQUIRE_THROW( settle( { "alice"_n }, { leg( "alice"_n, "bob"_n, "300 CERO" ),
+                                                 leg( "bob"_n, "alice"_n, "10.000 TKN" ) } ),
+                        missing_auth_exception );
+   BOOST_REQUIRE_EXCEPTION( settle( { "alice"_n }, { leg( "alice"_n, "bob"_n, "300.0 CERO" ) } ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("symbol precision mismatch") );
+   BOOST_REQUIRE_EXCEPTION( settle( { "alice"_n }, { leg( "alice"_n, "bob"_n, "300 NONE" ) } ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("token with symbol does not exist") );
+   // legs are netted, so carol can only send her balance plus what she receives in the same settlement
+   BOOST_REQUIRE_EXCEPTION( settle( { "alice"_n, "carol"_n }, { leg( "alice"_n, "carol"_n, "100 CERO" ),
+                                                                leg( "carol"_n, "bob"_n, "111 CERO" ) } ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("overdrawn balance") );
+
+   auto trace = settle( { "alice"_n, "bob"_n, "carol"_n }, { leg( "alice"_n, "bob"_n, "300 CERO" ),
+                                                           leg( "bob"_n, "carol"_n, "100 CERO" ),
+                                                           leg( "carol"_n, "alice"_n, "40 CERO" ),
+                                                           leg( "bob"_n, "alice"_n, "10.000 TKN" ),
+                                                           leg( "bob"_n, "carol"_n, "5.500 TKN" ) } );
+   // the settle action itself plus one notification per participant
+   BOOST_REQUIRE_EQUAL( 4, trace->action_traces.size() );
+
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,CERO"), mvo()
+      ("balance", "730 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("carol"_n, "0,CERO"), mvo()
+      ("balance", "70 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "3,TKN"), mvo()
+      ("balance", "10.000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "3,TKN"), mvo()
+      ("balance", "984.500 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("carol"_n, "3,TKN"), mvo()
+      ("balance", "5.500 TKN")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( token_metadata_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000.00 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_metadata("2,CERO"), mvo()
+      ("max_supply", "1000000.00 CERO")
+      ("issuer", "alice")
+   );
+
+   // issue and retire only rewrite the stat row
+   issue( "alice"_n, asset::from_string("1000.00 CERO"), "issue" );
+   BOOST_REQUIRE_EQUAL( success(), retire( "alice"_n, asset::from_string("100.00 CERO"), "retire" ) );
+   REQUIRE_MATCHING_OBJECT( get_stats("2,CERO"), mvo()
+      ("supply", "900.00 CERO")
+      ("max_supply", "1000000.00 CERO")
+      ("issuer", "alice")
+   );
+   REQUIRE_MATCHING_OBJECT( get_metadata("2,CERO"), mvo()
+      ("max_supply", "1000000.00 CERO")
+      ("issuer", "alice")
+   );
+
+   // transfers check the token and its precision against the metadata row
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("7.00 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfer( "alice"_n, "bob"_n, asset::from_string("7.0 CERO"), "hola" )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "unable to find key" ),
+      transfer( "alice"_n, "bob"_n, asset::from_string("7.00 NONE"), "hola" )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ), open( "carol"_n, "0,CERO", "bob"_n ) );
+
+   // create already recorded the metadata, initmeta is only for tokens created before it existed; it needs
+   // no authority, so the rejections below come from its checks
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "token metadata already recorded" ), initmeta( "bob"_n, "CERO" ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "token with symbol does not exist" ), initmeta( "bob"_n, "NONE" ) );
 
 } FC_LOG_AND_RETHROW()
 